@@ -10,10 +10,19 @@
 #include "Address.hpp"
 
 #include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+// offsetof
+#include <cstddef>
 
 // memset
 #include <string.h>
 
+// inet_ntop
+#include <arpa/inet.h>
+#include <sys/un.h>
+
 namespace Dream {
 	namespace Network {
 		AddressResolutionError::AddressResolutionError (const std::string & what, int error_code) : std::runtime_error(what), _error_code(error_code)
@@ -42,6 +51,15 @@ namespace Dream {
 			set_address_data(sa, size);
 		}
 
+		Address::Address (const sockaddr * sa, std::size_t size, SocketType socket_type, SocketProtocol socket_protocol)
+		{
+			set_address_data(sa, size);
+
+			_protocol_family = sa->sa_family;
+			_socket_type = socket_type;
+			_protocol = socket_protocol;
+		}
+
 		Address::Address (const addrinfo * ai) {
 			copy_from_address_info(ai);
 		}
@@ -65,6 +83,11 @@ namespace Dream {
 			return *this;
 		}
 
+		void Address::assign (const Address & copy, const sockaddr * sa, std::size_t size) {
+			copy_from_address(copy);
+			set_address_data(sa, size);
+		}
+
 		std::size_t Address::address_data_size () const
 		{
 			return _address_data_size;
@@ -287,6 +310,14 @@ namespace Dream {
 		};
 
 		PortNumber Address::port_number () const {
+			// The port is stored directly in the address, so there is no need to ask getnameinfo for it:
+			if (address_family() == AF_INET)
+				return ntohs(((const sockaddr_in *)&_address_data)->sin_port);
+			else if (address_family() == AF_INET6)
+				return ntohs(((const sockaddr_in6 *)&_address_data)->sin6_port);
+			else if (address_family() == AF_UNIX)
+				return 0;
+
 			std::string port_string;
 			PortNumber port = 0;
 
@@ -341,6 +372,12 @@ namespace Dream {
 		}
 
 		std::string Address::canonical_numeric_name () const {
+			char buffer[MAXIMUM_NUMERIC_LENGTH];
+			std::size_t length = format_numeric_host(buffer, sizeof(buffer));
+
+			if (length)
+				return std::string(buffer, length);
+
 			std::string host_string;
 
 			int err = name_info_for_address(&host_string, NULL, NI_NUMERICHOST);
@@ -367,7 +404,274 @@ namespace Dream {
 			return addresses_for_name(NULL, service, &hints);
 		}
 
+		// Leave an empty string in the buffer so that it can always be printed.
+		static std::size_t format_failed (char * buffer, std::size_t size) {
+			if (size > 0)
+				buffer[0] = '\0';
+
+			return 0;
+		}
+
+		bool Address::is_unix () const {
+			return address_family() == AF_UNIX;
+		}
+
+		std::string Address::unix_path () const {
+			if (!is_unix())
+				return std::string();
+
+			// Enough for the whole of sun_path, a leading '@' and a null terminator:
+			char buffer[sizeof(sockaddr_un) + 2];
+			std::size_t length = format_numeric(buffer, sizeof(buffer));
+
+			return std::string(buffer, length);
+		}
+
+		Address Address::unix_address (const std::string & path, SocketType socket_type) {
+			sockaddr_un address;
+			memset(&address, 0, sizeof(address));
+			address.sun_family = AF_UNIX;
+
+			std::size_t size = offsetof(sockaddr_un, sun_path);
+
+#ifdef __linux__
+			if (!path.empty() && path[0] == '@') {
+				// The abstract name is every byte following the leading null, without a terminator:
+				if (path.size() > sizeof(address.sun_path))
+					throw std::invalid_argument("Unix socket name is too long: " + path);
+
+				memcpy(address.sun_path + 1, path.data() + 1, path.size() - 1);
+				size += path.size();
+
+				return Address((const sockaddr *)&address, size, socket_type);
+			}
+#endif
+
+			if (path.size() + 1 > sizeof(address.sun_path))
+				throw std::invalid_argument("Unix socket path is too long: " + path);
+
+			memcpy(address.sun_path, path.data(), path.size());
+			size += path.size() + 1;
+
+			return Address((const sockaddr *)&address, size, socket_type);
+		}
+
+		std::size_t Address::format_numeric_host (char * buffer, std::size_t size) const {
+			const void * host = nullptr;
+
+			if (address_family() == AF_INET)
+				host = &((const sockaddr_in *)&_address_data)->sin_addr;
+			else if (address_family() == AF_INET6)
+				host = &((const sockaddr_in6 *)&_address_data)->sin6_addr;
+			else
+				return format_failed(buffer, size);
+
+			if (inet_ntop(address_family(), host, buffer, size) == nullptr)
+				return format_failed(buffer, size);
+
+			return strlen(buffer);
+		}
+
+		std::size_t Address::format_numeric (char * buffer, std::size_t size) const {
+			if (address_family() == AF_UNIX) {
+				const sockaddr_un * address = (const sockaddr_un *)&_address_data;
+				std::size_t offset = offsetof(sockaddr_un, sun_path);
+
+				if (_address_data_size <= offset)
+					return format_failed(buffer, size);
+
+				const char * path = address->sun_path;
+				std::size_t available = _address_data_size - offset;
+
+				// An abstract name starts with a null byte, and is written with a leading '@' instead:
+				std::size_t prefix = 0, length;
+
+				if (path[0] == '\0' && available > 1) {
+					prefix = 1;
+					path += 1;
+					length = available - 1;
+				} else {
+					// The path may not be null terminated if it fills sun_path:
+					length = strnlen(path, available);
+				}
+
+				if (prefix + length + 1 > size)
+					return format_failed(buffer, size);
+
+				if (prefix)
+					buffer[0] = '@';
+
+				memcpy(buffer + prefix, path, length);
+				buffer[prefix + length] = '\0';
+
+				return prefix + length;
+			}
+
+			if (size < 2)
+				return format_failed(buffer, size);
+
+			bool bracketed = address_family() == AF_INET6;
+			std::size_t offset = bracketed ? 1 : 0;
+
+			std::size_t length = format_numeric_host(buffer + offset, size - offset);
+
+			if (length == 0)
+				return format_failed(buffer, size);
+
+			if (bracketed) {
+				buffer[0] = '[';
+				length += 1;
+			}
+
+			// Enough for "]:65535":
+			char suffix[8];
+			std::size_t suffix_length = 0;
+
+			if (bracketed)
+				suffix[suffix_length++] = ']';
+
+			suffix[suffix_length++] = ':';
+
+			// Write the port digits in reverse, then flip them:
+			PortNumber port = port_number();
+			std::size_t digits_offset = suffix_length;
+
+			do {
+				suffix[suffix_length++] = '0' + (port % 10);
+				port /= 10;
+			} while (port);
+
+			std::reverse(suffix + digits_offset, suffix + suffix_length);
+
+			if (length + suffix_length + 1 > size)
+				return format_failed(buffer, size);
+
+			memcpy(buffer + length, suffix, suffix_length);
+			length += suffix_length;
+			buffer[length] = '\0';
+
+			return length;
+		}
+
+		// FNV-1a, which is cheap for the handful of bytes in an address.
+		static std::size_t hash_bytes (std::size_t hash, const void * data, std::size_t size)
+		{
+			const unsigned char * bytes = (const unsigned char *)data;
+
+			for (std::size_t i = 0; i < size; i += 1) {
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+
+			return hash;
+		}
+
+		std::size_t Address::hash_address_data (const sockaddr * address_data, std::size_t size)
+		{
+			std::size_t hash = 14695981039346656037ULL;
+
+			if (size == 0)
+				return hash;
+
+			AddressFamily family = address_data->sa_family;
+			hash = hash_bytes(hash, &family, sizeof(family));
+
+			// Only hash the fields which compare_address_data uses:
+			switch (family) {
+				case AF_INET: {
+					const sockaddr_in * address = (const sockaddr_in *)address_data;
+					hash = hash_bytes(hash, &address->sin_addr, sizeof(address->sin_addr));
+					hash = hash_bytes(hash, &address->sin_port, sizeof(address->sin_port));
+					break;
+				}
+				case AF_INET6: {
+					const sockaddr_in6 * address = (const sockaddr_in6 *)address_data;
+					hash = hash_bytes(hash, &address->sin6_addr, sizeof(address->sin6_addr));
+					hash = hash_bytes(hash, &address->sin6_port, sizeof(address->sin6_port));
+					hash = hash_bytes(hash, &address->sin6_scope_id, sizeof(address->sin6_scope_id));
+					break;
+				}
+				default:
+					hash = hash_bytes(hash, address_data, size);
+			}
+
+			return hash;
+		}
+
+		template <typename ValueT>
+		static int compare_values (const ValueT & a, const ValueT & b)
+		{
+			return (a < b) ? -1 : ((b < a) ? 1 : 0);
+		}
+
+		int Address::compare_address_data (const sockaddr * a, std::size_t a_size, const sockaddr * b, std::size_t b_size)
+		{
+			if (a_size == 0 || b_size == 0)
+				return compare_values(a_size, b_size);
+
+			if (int result = compare_values(a->sa_family, b->sa_family))
+				return result;
+
+			switch (a->sa_family) {
+				case AF_INET: {
+					const sockaddr_in * a_address = (const sockaddr_in *)a;
+					const sockaddr_in * b_address = (const sockaddr_in *)b;
+
+					// Network byte order compares numerically with memcmp:
+					if (int result = memcmp(&a_address->sin_addr, &b_address->sin_addr, sizeof(a_address->sin_addr)))
+						return result;
+
+					return compare_values(ntohs(a_address->sin_port), ntohs(b_address->sin_port));
+				}
+				case AF_INET6: {
+					const sockaddr_in6 * a_address = (const sockaddr_in6 *)a;
+					const sockaddr_in6 * b_address = (const sockaddr_in6 *)b;
+
+					if (int result = memcmp(&a_address->sin6_addr, &b_address->sin6_addr, sizeof(a_address->sin6_addr)))
+						return result;
+
+					if (int result = compare_values(ntohs(a_address->sin6_port), ntohs(b_address->sin6_port)))
+						return result;
+
+					return compare_values(a_address->sin6_scope_id, b_address->sin6_scope_id);
+				}
+				default:
+					if (int result = memcmp(a, b, std::min(a_size, b_size)))
+						return result;
+
+					return compare_values(a_size, b_size);
+			}
+		}
+
+		std::size_t Address::hash () const
+		{
+			return hash_bytes(hash_address_data(address_data(), address_data_size()), &_socket_type, sizeof(_socket_type));
+		}
+
+		bool Address::operator== (const Address & other) const
+		{
+			return _socket_type == other._socket_type && compare_address_data(address_data(), address_data_size(), other.address_data(), other.address_data_size()) == 0;
+		}
+
+		bool Address::operator< (const Address & other) const
+		{
+			if (int result = compare_address_data(address_data(), address_data_size(), other.address_data(), other.address_data_size()))
+				return result < 0;
+
+			return _socket_type < other._socket_type;
+		}
+
 		std::string Address::description () const {
+			// Unix paths may be longer than MAXIMUM_NUMERIC_LENGTH, and have no host name to fall back to:
+			if (is_unix())
+				return unix_path();
+
+			char buffer[MAXIMUM_NUMERIC_LENGTH];
+			std::size_t length = format_numeric(buffer, sizeof(buffer));
+
+			if (length)
+				return std::string(buffer, length);
+
 			std::stringstream s;
 
 			if (address_family() == AF_INET6) {
@@ -16,6 +16,7 @@
 
 #include <vector>
 #include <iosfwd>
+#include <functional>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -58,6 +59,10 @@ namespace Dream {
 		 the local interfaces and connect to remote interfaces.
 		 */
 		class Address {
+		public:
+			/// A buffer of this size is sufficient for format_numeric() with any IPv4 or IPv6 address, e.g. "[ffff:...:255.255.255.255]:65535".
+			static const std::size_t MAXIMUM_NUMERIC_LENGTH = INET6_ADDRSTRLEN + 8;
+
 		private:
 			void copy_from_address (const Address &);
 			void set_address_data (const sockaddr *, std::size_t size);
@@ -86,6 +91,8 @@ namespace Dream {
 
 			/// Construct from another address and a <tt>sockaddr *</tt>. This is used when receiving a connection, for example, from the bind system call.
 			Address (const Address & copy, sockaddr * sa, std::size_t size);
+			/// Construct from a <tt>sockaddr *</tt> and explicit socket details. The protocol family is taken from the address family.
+			Address (const sockaddr * sa, std::size_t size, SocketType socket_type, SocketProtocol socket_protocol = 0);
 			/// Construct from an addrinfo struct. This is used when using the new style APIs such as getaddrinfo.
 			Address (const addrinfo *);
 
@@ -94,6 +101,9 @@ namespace Dream {
 			/// Copy operator. Duplicates internal data structures.
 			Address & operator= (const Address &);
 
+			/// Reinitialize from another address and a <tt>sockaddr *</tt>, in place. Equivalent to assigning Address(copy, sa, size) without the temporary.
+			void assign (const Address & copy, const sockaddr * sa, std::size_t size);
+
 			/// Returns whether or not the address is valid or not. Even if an address is valid, it is not guaranteed to be successful in other operations.
 			bool is_valid () const;
 
@@ -139,9 +149,36 @@ namespace Dream {
 			/// Returns the numeric address.
 			std::string canonical_numeric_name () const;
 
-			/// A string that represents the address in a lossy human-readable form.
+			/// A string that represents the address in a lossy human-readable form. IPv4 and IPv6 addresses are formatted numerically without a reverse lookup.
 			std::string description () const;
 
+			/// Write the numeric host into the given buffer, e.g. "127.0.0.1" or "::1", without allocating or consulting the resolver. Returns the length written (excluding the null terminator), or 0 (leaving an empty string) if the address family isn't supported or the buffer is too small.
+			std::size_t format_numeric_host (char * buffer, std::size_t size) const;
+
+			/// Write the numeric host and port into the given buffer, e.g. "127.0.0.1:80" or "[::1]:80", without allocating or consulting the resolver. Unix addresses are written as their path. Returns the length written (excluding the null terminator), or 0 (leaving an empty string) on failure.
+			/// @sa MAXIMUM_NUMERIC_LENGTH
+			std::size_t format_numeric (char * buffer, std::size_t size) const;
+
+			/// Whether this is a unix-domain address.
+			bool is_unix () const;
+
+			/// The path of a unix-domain address. Names in the Linux abstract namespace are prefixed with '@'. Unnamed addresses, such as the peer of an accepted connection, have an empty path.
+			std::string unix_path () const;
+
+			/// Hash the significant parts of the address (family, host, port and socket type), consistent with operator==.
+			std::size_t hash () const;
+
+			/// Addresses are equal if they have the same socket type, family, host and port. Padding such as sin_zero and the IPv6 flow label are ignored.
+			bool operator== (const Address & other) const;
+			bool operator!= (const Address & other) const { return !(*this == other); }
+			/// A strict weak ordering, by family, then host in network order, then port, then socket type.
+			bool operator< (const Address & other) const;
+
+			/// Hash the significant parts of the given address data.
+			static std::size_t hash_address_data (const sockaddr * address_data, std::size_t size);
+			/// Compare the significant parts of the given address data, returning a value less than, equal to or greater than zero.
+			static int compare_address_data (const sockaddr * a, std::size_t a_size, const sockaddr * b, std::size_t b_size);
+
 			/// Returns addresses for binding a server on the local machine.
 			/// @sa ServerSocket::bind
 			static AddressesT interface_addresses_for (const Service & service, SocketType sock_type = SOCK_STREAM);
@@ -153,6 +190,10 @@ namespace Dream {
 			/// @sa ClientSocket::connect
 			static AddressesT addresses_for_name (const char * host, const Service & service, addrinfo * hints);
 
+			/// Returns an address for a unix-domain socket at the given path, for binding a ServerSocket or connecting a ClientSocket. The socket type may be SOCK_STREAM, SOCK_SEQPACKET or SOCK_DGRAM. On Linux, a path starting with '@' names a socket in the abstract namespace, which has no presence in the filesystem.
+			/// Throws std::invalid_argument if the path doesn't fit in sockaddr_un.
+			static Address unix_address (const std::string & path, SocketType socket_type = SOCK_STREAM);
+
 			/// Returns addresses for a given URI.
 			/// Format of the URI is service://hostname/
 			/// e.g. http://www.google.com or www.google.com:80
@@ -166,3 +207,15 @@ namespace Dream {
 		}
 	}
 }
+
+namespace std
+{
+	template <>
+	struct hash<Dream::Network::Address>
+	{
+		std::size_t operator() (const Dream::Network::Address & address) const
+		{
+			return address.hash();
+		}
+	};
+}
@@ -0,0 +1,194 @@
+//
+//  Admission.cpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include "Admission.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include <string.h>
+
+namespace Dream
+{
+	namespace Network
+	{
+		TokenBucket::TokenBucket (double rate, double burst) : _rate(rate), _burst(burst), _tokens(burst)
+		{
+		}
+		
+		void TokenBucket::update (TimeT now)
+		{
+			if (_updated >= 0 && now > _updated)
+				_tokens = std::min(_burst, _tokens + (now - _updated) * _rate);
+			
+			_updated = now;
+		}
+		
+		// The remote host, without the port, so that all connections from a host share a bucket.
+		static CompactAddress host_for (const Address & address)
+		{
+			sockaddr_storage host;
+			std::size_t size = address.address_data_size();
+			
+			memcpy(&host, address.address_data(), size);
+			
+			if (host.ss_family == AF_INET)
+				((sockaddr_in *)&host)->sin_port = 0;
+			else if (host.ss_family == AF_INET6)
+				((sockaddr_in6 *)&host)->sin6_port = 0;
+			
+			return CompactAddress((const sockaddr *)&host, size, address.socket_type());
+		}
+		
+		void AdmissionControl::update_enabled ()
+		{
+			_enabled = _global_enabled || _address_enabled || !_prefixes.empty();
+		}
+		
+		void AdmissionControl::set_global_limit (double rate, double burst)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			_global_enabled = rate > 0;
+			_global = TokenBucket(rate, burst);
+			
+			update_enabled();
+		}
+		
+		void AdmissionControl::set_address_limit (double rate, double burst)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			_address_enabled = rate > 0;
+			_address_rate = rate;
+			_address_burst = burst;
+			_addresses.clear();
+			
+			update_enabled();
+		}
+		
+		bool AdmissionControl::set_prefix_limit (const std::string & cidr, double rate, double burst)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if (!_prefixes.insert(cidr, _prefix_buckets.size()))
+				return false;
+			
+			_prefix_buckets.push_back(TokenBucket(rate, burst));
+			
+			update_enabled();
+			
+			return true;
+		}
+		
+		std::size_t AdmissionControl::tracked_address_count () const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			return _addresses.size();
+		}
+		
+		void AdmissionControl::prune_addresses (TimeT now)
+		{
+			for (auto entry = _addresses.begin(); entry != _addresses.end();) {
+				entry->second.update(now);
+				
+				if (entry->second.full())
+					entry = _addresses.erase(entry);
+				else
+					++entry;
+			}
+			
+			_pruned = now;
+		}
+		
+		void AdmissionControl::evict_address ()
+		{
+			std::size_t bucket_count = _addresses.bucket_count();
+			
+			// Start from a different hash bucket each time, so that the victim isn't always the most recently inserted host:
+			_eviction_cursor += 1;
+			
+			for (std::size_t i = 0; i < bucket_count; i += 1) {
+				std::size_t bucket = (_eviction_cursor * 2654435761u + i) % bucket_count;
+				
+				if (_addresses.bucket_size(bucket) > 0) {
+					_addresses.erase(_addresses.begin(bucket)->first);
+					
+					return;
+				}
+			}
+		}
+		
+		bool AdmissionControl::admit (const Address & address)
+		{
+			if (!_enabled) {
+				_admitted_count += 1;
+				
+				return true;
+			}
+			
+			auto now = std::chrono::duration<TimeT>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			
+			return admit(address, now);
+		}
+		
+		bool AdmissionControl::admit (const Address & address, TimeT now)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			TokenBucket * buckets[3];
+			std::size_t count = 0;
+			
+			if (!_prefixes.empty()) {
+				if (const std::size_t * index = _prefixes.lookup(address))
+					buckets[count++] = &_prefix_buckets[*index];
+			}
+			
+			if (_address_enabled) {
+				CompactAddress host = host_for(address);
+				auto entry = _addresses.find(host);
+				
+				if (entry == _addresses.end()) {
+					if (_addresses.size() >= maximum_tracked_addresses) {
+						if (_pruned < 0 || now - _pruned >= prune_interval)
+							prune_addresses(now);
+						
+						if (_addresses.size() >= maximum_tracked_addresses)
+							evict_address();
+					}
+					
+					entry = _addresses.emplace(host, TokenBucket(_address_rate, _address_burst)).first;
+				}
+				
+				buckets[count++] = &entry->second;
+			}
+			
+			if (_global_enabled)
+				buckets[count++] = &_global;
+			
+			for (std::size_t i = 0; i < count; i += 1) {
+				buckets[i]->update(now);
+				
+				if (!buckets[i]->ready()) {
+					_rejected_count += 1;
+					
+					return false;
+				}
+			}
+			
+			// Only consume tokens once the connection is known to be admitted, so that rejected connections don't drain the other buckets:
+			for (std::size_t i = 0; i < count; i += 1)
+				buckets[i]->take();
+			
+			_admitted_count += 1;
+			
+			return true;
+		}
+	}
+}
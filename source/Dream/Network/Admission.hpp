@@ -0,0 +1,108 @@
+//
+//  Admission.hpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#pragma once
+
+#include "CompactAddress.hpp"
+#include "PrefixTable.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Dream
+{
+	namespace Network
+	{
+		/// A token bucket which refills at a fixed rate up to a maximum burst.
+		class TokenBucket
+		{
+		public:
+			/// A bucket which refills at rate tokens per second, holding at most burst tokens. It starts full.
+			TokenBucket (double rate = 0, double burst = 0);
+			
+			/// Refill the bucket according to the time elapsed since it was last updated.
+			void update (TimeT now);
+			
+			/// Whether the bucket holds at least one token, as of the last update.
+			bool ready () const { return _tokens >= 1.0; }
+			/// Whether the bucket has refilled completely, as of the last update.
+			bool full () const { return _tokens >= _burst; }
+			
+			/// Remove one token, which must be available.
+			void take () { _tokens -= 1.0; }
+			
+		private:
+			double _rate, _burst;
+			double _tokens;
+			TimeT _updated = -1;
+		};
+		
+		/** Token bucket admission control for incoming connections.
+		
+		 A connection is admitted only if every applicable bucket has a token: the global bucket, the bucket for the remote host and the bucket for the most specific matching prefix. Admitting a connection takes a token from each of them. A prefix with a rate and burst of zero rejects all connections from that prefix.
+		 
+		 This is consulted by Server immediately after a connection is accepted, before any ClientSocket is created, and may be used from several threads.
+		 */
+		class AdmissionControl
+		{
+		public:
+			/// Limit the rate of all connections. A rate of zero removes the limit.
+			void set_global_limit (double rate, double burst);
+			
+			/// Limit the rate of connections from any one remote host (ignoring the port). A rate of zero removes the limit.
+			void set_address_limit (double rate, double burst);
+			
+			/// Limit the rate of connections from all hosts in the given prefix, in CIDR notation. All hosts in the prefix share one bucket. Returns false if the prefix is malformed.
+			bool set_prefix_limit (const std::string & cidr, double rate, double burst);
+			
+			/// Whether any limits are configured.
+			bool is_enabled () const { return _enabled; }
+			
+			/// Decide whether to admit a connection from the given address, updating the counters.
+			bool admit (const Address & address);
+			bool admit (const Address & address, TimeT now);
+			
+			std::size_t admitted_count () const { return _admitted_count; }
+			std::size_t rejected_count () const { return _rejected_count; }
+			
+			/// The number of remote hosts currently tracked by the per-address limit.
+			std::size_t tracked_address_count () const;
+			
+			/// Once this many hosts are tracked, hosts whose buckets have refilled are forgotten. If none have, an arbitrary host is forgotten to make room, so the table never grows beyond this size.
+			std::size_t maximum_tracked_addresses = 1024*64;
+			
+			/// Forgetting refilled hosts visits every tracked host, so it is done at most once per interval, in seconds.
+			TimeT prune_interval = 1.0;
+			
+		private:
+			mutable std::mutex _lock;
+			
+			std::atomic<bool> _enabled {false};
+			
+			bool _global_enabled = false;
+			TokenBucket _global;
+			
+			bool _address_enabled = false;
+			double _address_rate = 0, _address_burst = 0;
+			std::unordered_map<CompactAddress, TokenBucket> _addresses;
+			TimeT _pruned = -1;
+			std::size_t _eviction_cursor = 0;
+			
+			PrefixTable<std::size_t> _prefixes;
+			std::vector<TokenBucket> _prefix_buckets;
+			
+			std::atomic<std::size_t> _admitted_count {0}, _rejected_count {0};
+			
+			void update_enabled ();
+			void prune_addresses (TimeT now);
+			void evict_address ();
+		};
+	}
+}
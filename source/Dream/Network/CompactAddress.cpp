@@ -0,0 +1,158 @@
+//
+//  CompactAddress.cpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include "CompactAddress.hpp"
+
+#include <ostream>
+
+#include <string.h>
+
+namespace Dream
+{
+	namespace Network
+	{
+		CompactAddress::CompactAddress ()
+		{
+		}
+		
+		CompactAddress::CompactAddress (const Address & address) : _socket_type(address.socket_type()), _socket_protocol(address.socket_protocol())
+		{
+			if (address.is_valid())
+				assign(address.address_data(), address.address_data_size());
+		}
+		
+		CompactAddress::CompactAddress (const sockaddr * address_data, std::size_t size, SocketType socket_type, SocketProtocol socket_protocol) : _socket_type(socket_type), _socket_protocol(socket_protocol)
+		{
+			assign(address_data, size);
+		}
+		
+		CompactAddress::CompactAddress (const CompactAddress & other) : _socket_type(other._socket_type), _socket_protocol(other._socket_protocol)
+		{
+			assign(other.address_data(), other._size);
+		}
+		
+		CompactAddress::CompactAddress (CompactAddress && other) : _data(other._data), _size(other._size), _socket_type(other._socket_type), _socket_protocol(other._socket_protocol)
+		{
+			// Any external allocation now belongs to this address:
+			other._size = 0;
+		}
+		
+		CompactAddress & CompactAddress::operator= (const CompactAddress & other)
+		{
+			if (this != &other) {
+				release();
+				
+				_socket_type = other._socket_type;
+				_socket_protocol = other._socket_protocol;
+				
+				assign(other.address_data(), other._size);
+			}
+			
+			return *this;
+		}
+		
+		CompactAddress & CompactAddress::operator= (CompactAddress && other)
+		{
+			if (this != &other) {
+				release();
+				
+				_data = other._data;
+				_size = other._size;
+				_socket_type = other._socket_type;
+				_socket_protocol = other._socket_protocol;
+				
+				other._size = 0;
+			}
+			
+			return *this;
+		}
+		
+		CompactAddress::~CompactAddress ()
+		{
+			release();
+		}
+		
+		void CompactAddress::assign (const sockaddr * address_data, std::size_t size)
+		{
+			DREAM_ASSERT(size <= 0xFF);
+			
+			_size = (std::uint8_t)size;
+			
+			if (size == 0)
+				return;
+			
+			DREAM_ASSERT(address_data != nullptr);
+			
+			if (is_inline()) {
+				memcpy(_data.bytes, address_data, size);
+			} else {
+				_data.external = new unsigned char[size];
+				memcpy(_data.external, address_data, size);
+			}
+		}
+		
+		void CompactAddress::release ()
+		{
+			if (!is_inline())
+				delete[] _data.external;
+			
+			_size = 0;
+		}
+		
+		const sockaddr * CompactAddress::address_data () const
+		{
+			if (is_inline())
+				return (const sockaddr *)_data.bytes;
+			else
+				return (const sockaddr *)_data.external;
+		}
+		
+		AddressFamily CompactAddress::address_family () const
+		{
+			if (_size == 0)
+				return AF_UNSPEC;
+			
+			return address_data()->sa_family;
+		}
+		
+		PortNumber CompactAddress::port_number () const
+		{
+			switch (address_family()) {
+				case AF_INET:
+					return ntohs(((const sockaddr_in *)address_data())->sin_port);
+				case AF_INET6:
+					return ntohs(((const sockaddr_in6 *)address_data())->sin6_port);
+				default:
+					return 0;
+			}
+		}
+		
+		Address CompactAddress::to_address () const
+		{
+			if (_size == 0)
+				return Address();
+			
+			return Address(address_data(), _size, _socket_type, _socket_protocol);
+		}
+		
+		std::size_t CompactAddress::hash () const
+		{
+			return Address::hash_address_data(address_data(), _size) ^ _socket_type;
+		}
+		
+		bool CompactAddress::operator== (const CompactAddress & other) const
+		{
+			return _socket_type == other._socket_type && Address::compare_address_data(address_data(), _size, other.address_data(), other._size) == 0;
+		}
+		
+		std::ostream & operator<< (std::ostream & output, const CompactAddress & address)
+		{
+			return output << address.to_address();
+		}
+	}
+}
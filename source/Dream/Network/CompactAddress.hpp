@@ -0,0 +1,94 @@
+//
+//  CompactAddress.hpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#pragma once
+
+#include "Address.hpp"
+
+#include <cstdint>
+#include <functional>
+
+namespace Dream
+{
+	namespace Network
+	{
+		/** A space efficient address, suitable for keying large connection tables.
+		
+		 Address always reserves a full sockaddr_storage. CompactAddress stores IPv4, IPv6 and short unix addresses inline in their real size, and only allocates for unix addresses which don't fit. The protocol family is implied by the address family.
+		 */
+		class CompactAddress
+		{
+		public:
+			/// Blank constructor. is_valid() returns false.
+			CompactAddress ();
+			
+			CompactAddress (const Address & address);
+			CompactAddress (const sockaddr * address_data, std::size_t size, SocketType socket_type = SOCK_STREAM, SocketProtocol socket_protocol = 0);
+			
+			CompactAddress (const CompactAddress & other);
+			CompactAddress (CompactAddress && other);
+			
+			CompactAddress & operator= (const CompactAddress & other);
+			CompactAddress & operator= (CompactAddress && other);
+			
+			~CompactAddress ();
+			
+			/// Expand back into a full Address.
+			Address to_address () const;
+			
+			bool is_valid () const { return _size != 0; }
+			
+			/// Whether the address data is stored inline, i.e. without a separate allocation.
+			bool is_inline () const { return _size <= sizeof(_data.bytes); }
+			
+			std::size_t address_data_size () const { return _size; }
+			const sockaddr * address_data () const;
+			
+			AddressFamily address_family () const;
+			SocketType socket_type () const { return _socket_type; }
+			SocketProtocol socket_protocol () const { return _socket_protocol; }
+			
+			/// The port number for IPv4 and IPv6 addresses, otherwise 0.
+			PortNumber port_number () const;
+			
+			/// Hash the significant parts of the address, consistent with operator==.
+			std::size_t hash () const;
+			
+			bool operator== (const CompactAddress & other) const;
+			bool operator!= (const CompactAddress & other) const { return !(*this == other); }
+			
+		private:
+			void assign (const sockaddr * address_data, std::size_t size);
+			void release ();
+			
+			union {
+				sockaddr_in6 ipv6;
+				unsigned char bytes[sizeof(sockaddr_in6)];
+				unsigned char * external;
+			} _data;
+			
+			std::uint8_t _size = 0;
+			std::uint8_t _socket_type = 0;
+			std::uint16_t _socket_protocol = 0;
+		};
+		
+		std::ostream & operator<< (std::ostream & output, const CompactAddress & address);
+	}
+}
+
+namespace std
+{
+	template <>
+	struct hash<Dream::Network::CompactAddress>
+	{
+		std::size_t operator() (const Dream::Network::CompactAddress & address) const
+		{
+			return address.hash();
+		}
+	};
+}
@@ -0,0 +1,500 @@
+//
+//  Datagram.cpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include "Datagram.hpp"
+
+#include <Dream/Core/System.hpp>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <netinet/udp.h>
+
+#if defined(UDP_SEGMENT) && defined(UDP_GRO)
+#define DREAM_NETWORK_UDP_OFFLOAD
+#endif
+#endif
+
+namespace Dream
+{
+	namespace Network
+	{
+		using Core::SystemError;
+		
+		// The largest payload of a single UDP send, which bounds the total size of a segmented send.
+		static const std::size_t MAXIMUM_SEGMENTED_SIZE = 65507;
+		
+		// The size of each receive slab entry when the kernel may coalesce datagrams into it.
+		static const std::size_t MAXIMUM_COALESCED_SIZE = 65535;
+		
+		// Preallocated storage for a batch of datagrams, laid out as recvmmsg and sendmmsg expect.
+		struct DatagramSocket::Slab
+		{
+			// Ancillary data for offload: a UDP_SEGMENT size on send, or a UDP_GRO size on receive.
+			union Control {
+				char buffer[CMSG_SPACE(sizeof(int))];
+				struct cmsghdr alignment;
+			};
+			
+			std::vector<Byte> data;
+			std::vector<struct iovec> iovecs;
+			std::vector<sockaddr_storage> names;
+			std::vector<Control> controls;
+			
+#ifdef __linux__
+			std::vector<struct mmsghdr> messages;
+			
+			// Segmented sends, each spanning a run of consecutive entries.
+			std::vector<struct mmsghdr> runs;
+			std::vector<std::size_t> run_lengths;
+#else
+			std::vector<struct msghdr> messages;
+#endif
+			
+			std::size_t entry_size;
+			
+			Slab (std::size_t batch_size, std::size_t entry_size_) : data(batch_size * entry_size_), iovecs(batch_size), names(batch_size), controls(batch_size), messages(batch_size), entry_size(entry_size_)
+			{
+				memset(messages.data(), 0, sizeof(messages[0]) * batch_size);
+				
+				for (std::size_t i = 0; i < batch_size; i += 1) {
+					iovecs[i].iov_base = &data[i * entry_size];
+					iovecs[i].iov_len = entry_size;
+					
+					header(i).msg_iov = &iovecs[i];
+					header(i).msg_iovlen = 1;
+					header(i).msg_name = &names[i];
+					header(i).msg_namelen = sizeof(sockaddr_storage);
+				}
+			}
+			
+			struct msghdr & header (std::size_t index)
+			{
+#ifdef __linux__
+				return messages[index].msg_hdr;
+#else
+				return messages[index];
+#endif
+			}
+			
+			bool same_destination (std::size_t a, std::size_t b)
+			{
+				return header(a).msg_namelen == header(b).msg_namelen && memcmp(&names[a], &names[b], header(a).msg_namelen) == 0;
+			}
+		};
+		
+		DatagramSocket::DatagramSocket (const Address & local_address, std::size_t batch_size, std::size_t maximum_datagram_size) : _batch_size(batch_size), _maximum_datagram_size(maximum_datagram_size)
+		{
+			open_socket(local_address);
+			
+			if (::bind(_socket, local_address.address_data(), local_address.address_data_size()) == -1)
+				SystemError::check(__func__);
+			
+			set_will_block(false);
+			
+			allocate_slabs();
+		}
+		
+		DatagramSocket::DatagramSocket (AddressFamily address_family, std::size_t batch_size, std::size_t maximum_datagram_size) : _batch_size(batch_size), _maximum_datagram_size(maximum_datagram_size)
+		{
+			open_socket(address_family, SOCK_DGRAM);
+			
+			set_will_block(false);
+			
+			allocate_slabs();
+		}
+		
+		DatagramSocket::~DatagramSocket ()
+		{
+		}
+		
+		void DatagramSocket::allocate_slabs ()
+		{
+			DREAM_ASSERT(_batch_size > 0 && _maximum_datagram_size > 0);
+			
+			_receive_slab.reset(new Slab(_batch_size, _maximum_datagram_size));
+			_send_slab.reset(new Slab(_batch_size, _maximum_datagram_size));
+			
+			_received.resize(_batch_size);
+		}
+		
+		Address DatagramSocket::local_address () const
+		{
+			sockaddr_storage storage;
+			socklen_t size = sizeof(storage);
+			
+			if (::getsockname(_socket, (sockaddr *)&storage, &size) == -1)
+				SystemError::check(__func__);
+			
+			return Address((const sockaddr *)&storage, size, SOCK_DGRAM);
+		}
+		
+		const Datagram & DatagramSocket::received_datagram (std::size_t index) const
+		{
+			DREAM_ASSERT(index < _received_count);
+			
+			return _received[index];
+		}
+		
+		std::size_t DatagramSocket::receive ()
+		{
+			return try_receive().value("recvmmsg");
+		}
+		
+		IOResult DatagramSocket::try_receive ()
+		{
+			Slab & slab = *_receive_slab;
+			
+			_received_count = 0;
+			
+			// The kernel overwrites the name and control lengths and flags, so they must be reset for each batch.
+			for (std::size_t i = 0; i < _batch_size; i += 1) {
+				struct msghdr & header = slab.header(i);
+				
+				header.msg_namelen = sizeof(sockaddr_storage);
+				header.msg_flags = 0;
+				
+				if (_receive_offload) {
+					header.msg_control = slab.controls[i].buffer;
+					header.msg_controllen = sizeof(Slab::Control);
+				}
+			}
+			
+			std::size_t count = 0;
+			
+#ifdef __linux__
+			auto result = IOResult::from_system_call(::recvmmsg(_socket, slab.messages.data(), _batch_size, 0, nullptr));
+			
+			if (!result.is_ok())
+				return result;
+			
+			count = result.size;
+#else
+			for (; count < _batch_size; count += 1) {
+				ssize_t size = ::recvmsg(_socket, &slab.header(count), 0);
+				
+				// An empty datagram is not a shutdown, so only errors are interpreted.
+				if (size == -1) {
+					auto result = IOResult::from_system_call(size);
+					
+					// Report the datagrams which were received before the socket would block.
+					if (count > 0 && result.would_block())
+						break;
+					
+					return result;
+				}
+				
+				slab.iovecs[count].iov_len = size;
+			}
+#endif
+			
+			for (std::size_t i = 0; i < count; i += 1) {
+				struct msghdr & header = slab.header(i);
+				
+				const Byte * data = (const Byte *)slab.iovecs[i].iov_base;
+#ifdef __linux__
+				std::size_t size = slab.messages[i].msg_len;
+#else
+				std::size_t size = slab.iovecs[i].iov_len;
+				slab.iovecs[i].iov_len = slab.entry_size;
+#endif
+				
+				// A coalesced buffer holds several datagrams of segment_size bytes, the last of which may be smaller.
+				std::size_t segment_size = size;
+				
+#ifdef DREAM_NETWORK_UDP_OFFLOAD
+				if (_receive_offload) {
+					for (struct cmsghdr * control = CMSG_FIRSTHDR(&header); control; control = CMSG_NXTHDR(&header, control)) {
+						if (control->cmsg_level == SOL_UDP && control->cmsg_type == UDP_GRO) {
+							int value;
+							memcpy(&value, CMSG_DATA(control), sizeof(value));
+							
+							if (value > 0 && (std::size_t)value < size) {
+								segment_size = value;
+								_coalesced_receive_count += 1;
+							}
+						}
+					}
+				}
+#endif
+				
+				Address address((const sockaddr *)header.msg_name, header.msg_namelen, SOCK_DGRAM);
+				bool truncated = (header.msg_flags & MSG_TRUNC) != 0;
+				
+				// An empty datagram still produces one entry.
+				std::size_t offset = 0;
+				do {
+					if (_received_count == _received.size())
+						_received.resize(_received_count * 2);
+					
+					Datagram & datagram = _received[_received_count++];
+					
+					datagram.data = data + offset;
+					datagram.size = std::min(segment_size, size - offset);
+					datagram.address = address;
+					datagram.truncated = false;
+					
+					offset += datagram.size;
+				} while (offset < size);
+				
+				// Only the end of the buffer can have been discarded.
+				_received[_received_count - 1].truncated = truncated;
+			}
+			
+			return IOResult(IOStatus::OK, _received_count);
+		}
+		
+		bool DatagramSocket::set_receive_offload (bool enabled)
+		{
+#ifdef DREAM_NETWORK_UDP_OFFLOAD
+			int value = enabled ? 1 : 0;
+			
+			if (::setsockopt(_socket, SOL_UDP, UDP_GRO, &value, sizeof(value)) == -1)
+				return !enabled;
+			
+			_receive_offload = enabled;
+			
+			// Coalesced buffers can be up to the maximum UDP payload, regardless of the maximum datagram size.
+			_receive_slab.reset(new Slab(_batch_size, enabled ? MAXIMUM_COALESCED_SIZE : _maximum_datagram_size));
+			_received_count = 0;
+			
+			return true;
+#else
+			return !enabled;
+#endif
+		}
+		
+		bool DatagramSocket::set_segmentation_offload (bool enabled)
+		{
+#ifdef DREAM_NETWORK_UDP_OFFLOAD
+			if (enabled) {
+				int value = 0;
+				socklen_t size = sizeof(value);
+				
+				// Kernels without UDP_SEGMENT reject the option entirely.
+				if (::getsockopt(_socket, SOL_UDP, UDP_SEGMENT, &value, &size) == -1)
+					return false;
+			}
+			
+			_segmentation_offload = enabled;
+			
+			return true;
+#else
+			return !enabled;
+#endif
+		}
+		
+		bool DatagramSocket::queue (const Byte * data, std::size_t size, const Address & destination)
+		{
+			DREAM_ASSERT(size <= _maximum_datagram_size);
+			DREAM_ASSERT(destination.address_data_size() <= sizeof(sockaddr_storage));
+			
+			// Reuse the slab from the start once everything has been sent.
+			if (_sent_count == _queued_count)
+				_sent_count = _queued_count = 0;
+			
+			if (_queued_count == _batch_size)
+				return false;
+			
+			Slab & slab = *_send_slab;
+			std::size_t index = _queued_count;
+			
+			memcpy(slab.iovecs[index].iov_base, data, size);
+			slab.iovecs[index].iov_len = size;
+			
+			memcpy(&slab.names[index], destination.address_data(), destination.address_data_size());
+			slab.header(index).msg_namelen = destination.address_data_size();
+			
+			_queued_count += 1;
+			
+			return true;
+		}
+		
+		std::size_t DatagramSocket::flush ()
+		{
+			return try_flush().value("sendmmsg");
+		}
+		
+		IOResult DatagramSocket::try_flush ()
+		{
+#ifdef DREAM_NETWORK_UDP_OFFLOAD
+			if (_segmentation_offload)
+				return try_flush_segments();
+#endif
+			
+			Slab & slab = *_send_slab;
+			std::size_t sent = 0;
+			
+			while (_sent_count < _queued_count) {
+				std::size_t remaining = _queued_count - _sent_count;
+				
+#ifdef __linux__
+				auto result = IOResult::from_system_call(::sendmmsg(_socket, &slab.messages[_sent_count], remaining, 0));
+#else
+				auto result = IOResult::from_system_call(::sendmsg(_socket, &slab.header(_sent_count), 0));
+				
+				if (result.is_ok())
+					result.size = 1;
+#endif
+				
+				if (result.would_block())
+					break;
+				
+				if (!result.is_ok()) {
+					// The first datagram couldn't be sent, e.g. because the destination is unreachable. Drop it rather than retrying forever.
+					_sent_count += 1;
+					
+					return result;
+				}
+				
+				_sent_count += result.size;
+				sent += result.size;
+			}
+			
+			if (_sent_count == _queued_count)
+				_sent_count = _queued_count = 0;
+			
+			if (sent == 0 && _queued_count > 0)
+				return IOResult(IOStatus::WOULD_BLOCK);
+			
+			return IOResult(IOStatus::OK, sent);
+		}
+		
+		IOResult DatagramSocket::try_flush_segments ()
+		{
+#ifdef DREAM_NETWORK_UDP_OFFLOAD
+			Slab & slab = *_send_slab;
+			std::size_t sent = 0;
+			
+			if (slab.runs.empty()) {
+				slab.runs.resize(_batch_size);
+				slab.run_lengths.resize(_batch_size);
+			}
+			
+			while (_sent_count < _queued_count) {
+				std::size_t run_count = 0;
+				
+				// Group consecutive datagrams into runs which the kernel can split back into the original datagrams.
+				for (std::size_t index = _sent_count; index < _queued_count; run_count += 1) {
+					std::size_t segment_size = slab.iovecs[index].iov_len;
+					std::size_t length = 1, total = segment_size;
+					
+					while (segment_size > 0 && index + length < _queued_count && length < MAXIMUM_SEGMENTS) {
+						std::size_t next = index + length;
+						std::size_t size = slab.iovecs[next].iov_len;
+						
+						if (size == 0 || size > segment_size || total + size > MAXIMUM_SEGMENTED_SIZE || !slab.same_destination(index, next))
+							break;
+						
+						total += size;
+						length += 1;
+						
+						// Only the last datagram of a run may be smaller than the segment size.
+						if (size < segment_size)
+							break;
+					}
+					
+					struct msghdr & run = slab.runs[run_count].msg_hdr;
+					memset(&run, 0, sizeof(run));
+					
+					run.msg_iov = &slab.iovecs[index];
+					run.msg_iovlen = length;
+					run.msg_name = &slab.names[index];
+					run.msg_namelen = slab.header(index).msg_namelen;
+					
+					if (length > 1) {
+						run.msg_control = slab.controls[run_count].buffer;
+						run.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+						
+						struct cmsghdr * control = CMSG_FIRSTHDR(&run);
+						control->cmsg_level = SOL_UDP;
+						control->cmsg_type = UDP_SEGMENT;
+						control->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+						
+						uint16_t value = segment_size;
+						memcpy(CMSG_DATA(control), &value, sizeof(value));
+					}
+					
+					slab.run_lengths[run_count] = length;
+					index += length;
+				}
+				
+				auto result = IOResult::from_system_call(::sendmmsg(_socket, slab.runs.data(), run_count, 0));
+				
+				if (result.would_block())
+					break;
+				
+				if (!result.is_ok()) {
+					// The kernel or the outgoing device may not support segmentation, in which case send the datagrams individually from now on.
+					if (slab.run_lengths[0] > 1 && (result.error == EIO || result.error == EINVAL || result.error == ENOPROTOOPT || result.error == EOPNOTSUPP)) {
+						_segmentation_offload = false;
+						
+						IOResult remainder = try_flush();
+						
+						if (remainder.is_ok())
+							remainder.size += sent;
+						
+						return remainder;
+					}
+					
+					// Otherwise drop the first run, as try_flush drops a single datagram.
+					_sent_count += slab.run_lengths[0];
+					
+					return result;
+				}
+				
+				for (std::size_t i = 0; i < result.size; i += 1) {
+					if (slab.run_lengths[i] > 1)
+						_segmented_send_count += 1;
+					
+					_sent_count += slab.run_lengths[i];
+					sent += slab.run_lengths[i];
+				}
+			}
+			
+			if (_sent_count == _queued_count)
+				_sent_count = _queued_count = 0;
+			
+			if (sent == 0 && _queued_count > 0)
+				return IOResult(IOStatus::WOULD_BLOCK);
+			
+			return IOResult(IOStatus::OK, sent);
+#else
+			return IOResult(IOStatus::OK, 0);
+#endif
+		}
+		
+		void DatagramSocket::process_events (Events::Loop * event_loop, Events::Event events)
+		{
+			if (events & Events::READ_READY) {
+				for (std::size_t batch = 0; receive_budget == 0 || batch < receive_budget; batch += 1) {
+					IOResult result = try_receive();
+					
+					if (!result.is_ok() || result.size == 0)
+						break;
+					
+					if (datagrams_received_callback)
+						datagrams_received_callback(this);
+					
+					// A partial batch means there is nothing more waiting. With receive offload, the number of datagrams says nothing about how full the batch was.
+					if (!_receive_offload && result.size < _batch_size)
+						break;
+				}
+			}
+			
+			if ((events & Events::WRITE_READY) && queued_count() > 0)
+				try_flush();
+		}
+	}
+}
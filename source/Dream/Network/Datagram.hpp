@@ -0,0 +1,127 @@
+//
+//  Datagram.hpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#pragma once
+
+#include "Socket.hpp"
+
+#include <memory>
+
+namespace Dream
+{
+	namespace Network
+	{
+		/// A datagram which has been received, referring to memory owned by the DatagramSocket. It is only valid until the next receive.
+		struct Datagram
+		{
+			const Byte * data;
+			std::size_t size;
+			
+			/// The sender of the datagram.
+			Address address;
+			
+			/// The datagram was larger than the maximum datagram size, and the remainder was discarded.
+			bool truncated;
+		};
+		
+		/** A connectionless socket which sends and receives datagrams in batches.
+		
+		 Receiving fills a preallocated slab with up to batch_size datagrams using a single recvmmsg, and sending flushes up to batch_size queued datagrams using a single sendmmsg, where these are available. No memory is allocated per datagram; sender addresses are written into preallocated Address instances.
+		 
+		 On Linux, segmentation offload (UDP_SEGMENT) sends runs of equally sized datagrams to the same destination as one large buffer which the kernel splits, and receive offload (UDP_GRO) lets the kernel coalesce datagrams from the same sender into one large buffer which is split again on receipt. Either way, datagrams are presented individually.
+		 */
+		class DatagramSocket : public Socket
+		{
+		public:
+			/// Create a socket bound to the given local address.
+			DatagramSocket (const Address & local_address, std::size_t batch_size = 64, std::size_t maximum_datagram_size = 2048);
+			
+			/// Create an unbound socket of the given family, suitable for sending. The kernel assigns a local port on the first send.
+			DatagramSocket (AddressFamily address_family, std::size_t batch_size = 64, std::size_t maximum_datagram_size = 2048);
+			
+			virtual ~DatagramSocket ();
+			
+			/// The local address, as assigned by the kernel, e.g. when bound to port 0.
+			Address local_address () const;
+			
+			std::size_t batch_size () const { return _batch_size; }
+			std::size_t maximum_datagram_size () const { return _maximum_datagram_size; }
+			
+			/// Receive up to batch_size datagrams, replacing the previously received datagrams.
+			/// @returns the number of datagrams received, which is 0 if none are waiting.
+			std::size_t receive ();
+			
+			/// Receive datagrams, reporting would-block and errors as a result rather than throwing. The size of the result is the number of datagrams.
+			IOResult try_receive ();
+			
+			/// The datagrams from the most recent receive.
+			std::size_t received_count () const { return _received_count; }
+			const Datagram & received_datagram (std::size_t index) const;
+			
+			/// Copy a datagram into the send slab, to be sent to the destination by the next flush.
+			/// @returns false if batch_size datagrams are already queued, in which case flush first.
+			bool queue (const Byte * data, std::size_t size, const Address & destination);
+			
+			/// The number of datagrams queued for sending.
+			std::size_t queued_count () const { return _queued_count - _sent_count; }
+			
+			/// Send queued datagrams.
+			/// @returns the number of datagrams sent, which may be fewer than were queued if the socket would block.
+			std::size_t flush ();
+			
+			/// Send queued datagrams, reporting would-block and errors as a result rather than throwing. The size of the result is the number of datagrams. A datagram which fails to send is discarded, so that it doesn't prevent the remainder from being sent.
+			IOResult try_flush ();
+			
+			/// Send runs of up to MAXIMUM_SEGMENTS queued datagrams of equal size to the same destination with a single UDP_SEGMENT send. The last datagram of a run may be smaller.
+			/// @returns false if segmentation offload isn't supported, in which case datagrams are sent individually.
+			bool set_segmentation_offload (bool enabled = true);
+			bool segmentation_offload () const { return _segmentation_offload; }
+			
+			/// Allow the kernel to coalesce received datagrams from the same sender with UDP_GRO. This reallocates the receive slab so that each entry can hold a coalesced buffer, so received_count() may exceed batch_size.
+			/// @returns false if receive offload isn't supported.
+			bool set_receive_offload (bool enabled = true);
+			bool receive_offload () const { return _receive_offload; }
+			
+			/// The kernel limit on the number of segments in a single offloaded send.
+			static const std::size_t MAXIMUM_SEGMENTS = 64;
+			
+			/// The number of sends which used segmentation offload, and the number of coalesced buffers received.
+			std::size_t segmented_send_count () const { return _segmented_send_count; }
+			std::size_t coalesced_receive_count () const { return _coalesced_receive_count; }
+			
+			/// Receives batches of datagrams when readable, invoking datagrams_received_callback for each batch, and flushes queued datagrams when writable.
+			virtual void process_events (Events::Loop *, Events::Event);
+			
+			/// The maximum number of batches received per READ_READY event, so that other sources on the runloop are still serviced.
+			std::size_t receive_budget = 16;
+			
+			/// Delegate function called after each batch of datagrams is received.
+			std::function<void (DatagramSocket *)> datagrams_received_callback;
+			
+		private:
+			struct Slab;
+			
+			std::size_t _batch_size, _maximum_datagram_size;
+			
+			std::unique_ptr<Slab> _receive_slab, _send_slab;
+			
+			std::vector<Datagram> _received;
+			std::size_t _received_count = 0;
+			
+			std::size_t _queued_count = 0, _sent_count = 0;
+			
+			bool _segmentation_offload = false, _receive_offload = false;
+			std::size_t _segmented_send_count = 0, _coalesced_receive_count = 0;
+			
+			void allocate_slabs ();
+			
+			/// Send queued datagrams as runs of segments.
+			IOResult try_flush_segments ();
+		};
+	}
+}
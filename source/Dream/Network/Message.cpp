@@ -9,51 +9,145 @@
 
 #include "Message.hpp"
 
+#include <algorithm>
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+
 namespace Dream {
 	namespace Network {
+		Message::Message () {
+			_packet = new BufferT;
+		}
+
+		Message::Message (Ref<MessagePool> pool, Shared<BufferT> packet) : _packet(packet), _pool(pool) {
+		}
+
+		Message::~Message () {
+			if (_pool)
+				_pool->release(_packet);
+		}
 
 		const MessageHeader * Message::header () const {
 			DREAM_ASSERT(header_complete());
 
-			return (const MessageHeader*)_packet.begin();
+			return (const MessageHeader*)_packet->begin();
 		}
 
 		MessageHeader * Message::header () {
 			DREAM_ASSERT(header_complete());
 
-			return (MessageHeader*)&(_packet[0]);
+			return (MessageHeader*)&(*_packet)[0];
 		}
 
 		uint32_t Message::header_length () const {
 			return sizeof(MessageHeader);
 		}
 
+		static std::size_t encode_varint (uint32_t value, Byte * buffer) {
+			std::size_t offset = 0;
+
+			while (value >= 0x80) {
+				buffer[offset++] = (value & 0x7F) | 0x80;
+				value >>= 7;
+			}
+
+			buffer[offset++] = value;
+
+			return offset;
+		}
+
+		// Returns the number of bytes decoded, 0 if more data is required, or Message::MALFORMED_HEADER if the value exceeds maximum_value or needs more than maximum_length bytes.
+		static std::size_t decode_varint (const Byte * begin, const Byte * end, std::size_t maximum_length, uint32_t maximum_value, uint32_t & value) {
+			uint64_t result = 0;
+
+			for (std::size_t offset = 0; offset < maximum_length; offset += 1) {
+				if (begin + offset >= end)
+					return 0;
+
+				result |= (uint64_t)(begin[offset] & 0x7F) << (7 * offset);
+
+				// Discarding the high bits would silently corrupt the value:
+				if (result > maximum_value)
+					return Message::MALFORMED_HEADER;
+
+				if ((begin[offset] & 0x80) == 0) {
+					value = result;
+
+					return offset + 1;
+				}
+			}
+
+			return Message::MALFORMED_HEADER;
+		}
+
+		std::size_t Message::header_length (MessageFraming framing) const {
+			if (framing == MessageFraming::VARINT) {
+				Byte buffer[MAXIMUM_VARINT_HEADER_LENGTH];
+
+				return encode_header(framing, buffer);
+			}
+
+			return header_length();
+		}
+
+		std::size_t Message::encode_header (MessageFraming framing, Byte * buffer) const {
+			if (framing == MessageFraming::VARINT) {
+				std::size_t offset = encode_varint(header()->length, buffer);
+				offset += encode_varint(header()->packet_type, buffer + offset);
+
+				return offset;
+			}
+
+			std::memcpy(buffer, header(), header_length());
+
+			return header_length();
+		}
+
+		std::size_t Message::decode_varint_header (const Byte * begin, const Byte * end, uint32_t & length, uint16_t & packet_type) {
+			std::size_t length_size = decode_varint(begin, end, 5, 0xFFFFFFFF, length);
+
+			if (length_size == 0 || length_size == MALFORMED_HEADER)
+				return length_size;
+
+			uint32_t type = 0;
+			std::size_t type_size = decode_varint(begin + length_size, end, 3, 0xFFFF, type);
+
+			if (type_size == 0 || type_size == MALFORMED_HEADER)
+				return type_size;
+
+			packet_type = type;
+
+			return length_size + type_size;
+		}
+
 		uint32_t Message::data_length () const {
-			return _packet.size() - header_length();
+			return _packet->size() - header_length();
 		}
 
 		// These xxx_complete methods are typically used for building messages
 		// from incoming data..
 		bool Message::header_complete () const {
-			return _packet.size() >= header_length();
+			return _packet->size() >= header_length();
 		}
 
 		bool Message::data_complete () const {
-			return header_complete() && _packet.size() == (header_length() + header()->length);
+			return header_complete() && _packet->size() == (header_length() + header()->length);
 		}
 
 		const BufferT & Message::packet () const {
-			return _packet;
+			return *_packet;
 		}
 
 		BufferT & Message::packet () {
-			return _packet;
+			return *_packet;
 		}
 
 		void Message::reset_header () {
 			// Allocate space for header...
-			if (_packet.size() < header_length()) {
-				_packet.resize(header_length());
+			if (_packet->size() < header_length()) {
+				_packet->resize(header_length());
 			}
 
 			MessageHeader * h = header();
@@ -63,7 +157,7 @@ namespace Dream {
 		}
 
 		void Message::update_size () {
-			DREAM_ASSERT(_packet.size() >= header_length());
+			DREAM_ASSERT(_packet->size() >= header_length());
 
 			header()->length = data_length();
 		}
@@ -72,20 +166,91 @@ namespace Dream {
 			return header_complete() && data_complete();
 		}
 
+// MARK: -
+// MARK: MessagePool
+
+		MessagePool::MessagePool (std::size_t maximum_count, std::size_t maximum_capacity) : _maximum_count(maximum_count), _maximum_capacity(maximum_capacity) {
+		}
+
+		MessagePool::~MessagePool () {
+		}
+
+		Ref<Message> MessagePool::allocate () {
+			Shared<BufferT> packet;
+
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+
+				if (_buffers.size() > 0) {
+					packet = _buffers.back();
+					_buffers.pop_back();
+
+					_hit_count += 1;
+				} else {
+					_miss_count += 1;
+				}
+			}
+
+			if (!packet)
+				packet = new BufferT;
+
+			return new Message(this, packet);
+		}
+
+		void MessagePool::release (Shared<BufferT> packet) {
+			if (packet->capacity() > _maximum_capacity)
+				return;
+
+			// Retain the capacity but discard the contents.
+			packet->resize(0);
+
+			std::lock_guard<std::mutex> lock(_lock);
+
+			if (_buffers.size() < _maximum_count)
+				_buffers.push_back(packet);
+		}
+
+		std::size_t MessagePool::size () const {
+			std::lock_guard<std::mutex> lock(_lock);
+
+			return _buffers.size();
+		}
+
+		std::size_t MessagePool::hit_count () const {
+			std::lock_guard<std::mutex> lock(_lock);
+
+			return _hit_count;
+		}
+
+		std::size_t MessagePool::miss_count () const {
+			std::lock_guard<std::mutex> lock(_lock);
+
+			return _miss_count;
+		}
+
+		double MessagePool::hit_rate () const {
+			std::lock_guard<std::mutex> lock(_lock);
+
+			std::size_t total = _hit_count + _miss_count;
+
+			return total ? (double)_hit_count / total : 0.0;
+		}
+
 // MARK: -
 // MARK: MessageSender
 
-		MessageSender::MessageSender (Ref<Message> msg) {
+		MessageSender::MessageSender (Ref<Message> msg, MessageFraming framing) : _framing(framing) {
 			reset(msg);
 		}
 
-		MessageSender::MessageSender () {
+		MessageSender::MessageSender (MessageFraming framing) : _framing(framing) {
 			reset();
 		}
 
 		void MessageSender::reset () {
 			_message = NULL;
 			_offset = 0;
+			_header_length = 0;
 		}
 
 		void MessageSender::reset (Ref<Message> msg) {
@@ -93,6 +258,12 @@ namespace Dream {
 
 			_message = msg;
 			_offset = 0;
+
+			// The packed header is sent directly from the packet.
+			if (_framing == MessageFraming::PACKED)
+				_header_length = 0;
+			else
+				_header_length = _message->encode_header(_framing, _header);
 		}
 
 		bool MessageSender::has_message_to_send () const {
@@ -100,7 +271,10 @@ namespace Dream {
 		}
 
 		bool MessageSender::transmission_complete () const {
-			return _offset == _message->packet().size();
+			if (_header_length)
+				return _offset == _header_length + _message->data_length();
+			else
+				return _offset == _message->packet().size();
 		}
 
 		bool MessageSender::send_via_socket(ClientSocket * socket) {
@@ -109,7 +283,14 @@ namespace Dream {
 
 			BufferT &packet = _message->packet();
 
-			_offset += socket->send(packet, _offset);
+			if (_header_length == 0) {
+				_offset += socket->send(packet, _offset);
+			} else if (_offset < _header_length) {
+				_offset += socket->send(_header + _offset, _header_length - _offset);
+			} else if (!transmission_complete()) {
+				// Skip the packed header stored in the packet:
+				_offset += socket->send(packet, _message->header_length() + (_offset - _header_length));
+			}
 
 			/*
 			 if (!transmission_complete()) {
@@ -125,35 +306,166 @@ namespace Dream {
 // MARK: -
 // MARK: MessageReceiver
 
-		MessageReceiver::MessageReceiver () {
+		MessageReceiver::MessageReceiver (MessageFraming framing, std::size_t read_ahead_size) : _framing(framing), _read_ahead_size(read_ahead_size) {
+			_input.reserve(_read_ahead_size);
+
 			reset();
 		}
 
+		void MessageReceiver::set_message_pool (Ref<MessagePool> message_pool) {
+			_message_pool = message_pool;
+
+			// Don't discard a partially received message.
+			if (_message->packet().size() == 0)
+				reset();
+		}
+
 		void MessageReceiver::reset () {
-			_message = new Message;
+			if (_message_pool)
+				_message = _message_pool->allocate();
+			else
+				_message = new Message;
 		}
 
 		Ref<Message> MessageReceiver::message () {
 			return _message;
 		}
 
-		bool MessageReceiver::receive_from_socket (ClientSocket * socket) {
-			std::size_t sz = 1;
+		bool MessageReceiver::decode_header (const Byte *& begin, const Byte * end, IOResult & result) {
+			if (_framing == MessageFraming::VARINT) {
+				uint32_t length = 0;
+				uint16_t packet_type = 0;
+				std::size_t header_length = Message::decode_varint_header(begin, end, length, packet_type);
+
+				if (header_length == 0)
+					return false;
+
+				// Waiting for more data would never help, and the read-ahead buffer would fill up without being consumed:
+				if (header_length == Message::MALFORMED_HEADER) {
+					result = IOResult(IOStatus::FAILED, 0, EPROTO);
+
+					return false;
+				}
+
+				_message->reset_header();
+				_message->header()->length = length;
+				_message->header()->packet_type = packet_type;
+
+				begin += header_length;
+			} else {
+				std::size_t header_length = _message->header_length();
+
+				if ((std::size_t)(end - begin) < header_length)
+					return false;
+
+				BufferT & packet = _message->packet();
+				packet.resize(header_length);
+				std::memcpy(&packet[0], begin, header_length);
+
+				begin += header_length;
+			}
+
+			// Make room for the data up front, so that the packet doesn't grow incrementally.
+			_message->packet().reserve(_message->header_length() + _message->header()->length);
+
+			return true;
+		}
+
+		void MessageReceiver::compact_input () {
+			if (_input_offset == 0)
+				return;
+
+			std::size_t remaining = _input.size() - _input_offset;
+
+			if (remaining > 0)
+				std::memmove(&_input[0], &_input[_input_offset], remaining);
+
+			_input.resize(remaining);
+			_input_offset = 0;
+		}
+
+		std::size_t MessageReceiver::parse_input (MessageQueueT & messages, IOResult & result) {
+			std::size_t count = 0;
 
-			// Read as much data as possible:
-			while (sz > 0 && !_message->data_complete()) {
+			const Byte * begin = _input.begin() + _input_offset;
+			const Byte * end = _input.begin() + _input.size();
+
+			while (true) {
 				if (!_message->header_complete()) {
-					_message->packet().reserve(_message->header_length());
+					if (!decode_header(begin, end, result))
+						break;
+				}
+
+				if (!_message->data_complete()) {
+					BufferT & packet = _message->packet();
+
+					std::size_t offset = packet.size();
+					std::size_t amount = std::min<std::size_t>(_message->header_length() + _message->header()->length - offset, end - begin);
+
+					if (amount > 0) {
+						packet.resize(offset + amount);
+						std::memcpy(&packet[offset], begin, amount);
+
+						begin += amount;
+					}
+
+					if (!_message->data_complete())
+						break;
+				}
+
+				messages.push(_message);
+				reset();
+
+				count += 1;
+			}
+
+			_input_offset = begin - _input.begin();
+
+			return count;
+		}
+
+		std::size_t MessageReceiver::receive_from_socket (ClientSocket * socket, MessageQueueT & messages) {
+			IOResult result;
+			std::size_t count = receive_from_socket(socket, messages, result);
+
+			if (result.is_disconnected())
+				result.value("read");
+
+			return count;
+		}
+
+		std::size_t MessageReceiver::receive_from_socket (ClientSocket * socket, MessageQueueT & messages, IOResult & result) {
+			if (_message->header_complete() && !_message->data_complete()) {
+				BufferT & packet = _message->packet();
+				std::size_t remaining = _message->header_length() + _message->header()->length - packet.size();
+
+				// Large messages are received directly into the packet, rather than being copied through the read-ahead buffer. We read exactly the
+				// remaining data, so as not to consume any of the following message.
+				if (remaining >= _read_ahead_size / 2) {
+					std::size_t offset = packet.size();
 
-					sz = socket->recv(_message->packet());
-				} else if (!_message->data_complete()) {
-					_message->packet().reserve(_message->header_length() + _message->header()->length);
+					packet.resize(offset + remaining);
+					result = socket->try_recv(&packet[offset], remaining);
+					packet.resize(offset + (result.is_ok() ? result.size : 0));
 
-					sz = socket->recv(_message->packet());
+					if (!_message->data_complete())
+						return 0;
+
+					messages.push(_message);
+					reset();
+
+					return 1;
 				}
 			}
 
-			return _message->data_complete();
+			compact_input();
+
+			result = socket->try_recv(_input);
+
+			if (!result.is_ok())
+				return 0;
+
+			return parse_input(messages, result);
 		}
 
 // MARK: -
@@ -163,16 +475,44 @@ namespace Dream {
 
 		MessageClientSocket::MessageClientSocket (const SocketHandleT & h, const Address & address) : ClientSocket(h, address)
 		{
+			_receiver.set_message_pool(new MessagePool(8));
 		}
 
 		MessageClientSocket::MessageClientSocket () {
+			_receiver.set_message_pool(new MessagePool(8));
+		}
+
+		void MessageClientSocket::set_message_pool (Ref<MessagePool> message_pool) {
+			_receiver.set_message_pool(message_pool);
 		}
 
 		MessageClientSocket::~MessageClientSocket () {
 		}
 
+		void MessageClientSocket::set_framing (MessageFraming framing) {
+			_framing = framing;
+			_receiver.set_framing(framing);
+		}
+
+		bool MessageClientSocket::set_zero_copy_threshold (std::size_t threshold) {
+			if (threshold && !set_zero_copy(true)) {
+				_output_stream.set_zero_copy_threshold(0);
+
+				return false;
+			}
+
+			_output_stream.set_zero_copy_threshold(threshold);
+
+			return true;
+		}
+
 		void MessageClientSocket::flush_send_queue () {
 			_sendq = QueueT();
+			_sendq_bytes = 0;
+
+			_write_interest = !_output_stream.empty();
+
+			update_watermarks();
 		}
 
 		void MessageClientSocket::flush_receive_queue () {
@@ -180,11 +520,113 @@ namespace Dream {
 		}
 
 		bool MessageClientSocket::has_messages_to_send () {
-			return _sender.has_message_to_send() || _sendq.size() > 0;
+			return !_output_stream.empty() || _sendq.size() > 0;
+		}
+
+		std::size_t MessageClientSocket::wire_length (const Message * msg) const {
+			return msg->header_length(_framing) + msg->data_length();
 		}
 
-		void MessageClientSocket::send_message (Ref<Message> msg) {
+		void MessageClientSocket::set_send_watermarks (std::size_t low, std::size_t high) {
+			DREAM_ASSERT(low <= high);
+
+			_low_watermark = low;
+			_high_watermark = high;
+
+			update_watermarks();
+		}
+
+		void MessageClientSocket::set_send_limit (std::size_t limit, SendLimitPolicy policy) {
+			_send_limit = limit;
+			_send_limit_policy = policy;
+		}
+
+		void MessageClientSocket::update_watermarks () {
+			std::size_t queued = queued_bytes();
+
+			if (!_send_paused) {
+				if (_high_watermark && queued >= _high_watermark) {
+					_send_paused = true;
+
+					if (send_paused_callback)
+						send_paused_callback(this);
+				}
+			} else if (queued <= _low_watermark || !_high_watermark) {
+				_send_paused = false;
+
+				if (send_resumed_callback)
+					send_resumed_callback(this);
+			}
+		}
+
+		bool MessageClientSocket::wait_for_send_space (std::size_t size) {
+			while (has_messages_to_send() && queued_bytes() + size > _send_limit) {
+				struct pollfd descriptor;
+				descriptor.fd = file_descriptor();
+				descriptor.events = POLLOUT;
+				descriptor.revents = 0;
+
+				if (::poll(&descriptor, 1, -1) == -1) {
+					if (errno == EINTR)
+						continue;
+
+					return false;
+				}
+
+				IOResult result;
+				update_sender(result);
+
+				// The failure will be reported when the socket is next processed.
+				if (result.is_disconnected())
+					return false;
+			}
+
+			return true;
+		}
+
+		bool MessageClientSocket::send_message (Ref<Message> msg) {
+			std::size_t size = wire_length(msg.get());
+
+			if (_send_limit_exceeded)
+				return false;
+
+			if (_send_limit && has_messages_to_send() && queued_bytes() + size > _send_limit) {
+				switch (_send_limit_policy) {
+					case SendLimitPolicy::DROP:
+						_dropped_message_count += 1;
+
+						return false;
+
+					case SendLimitPolicy::DISCONNECT:
+						_dropped_message_count += _sendq.size() + 1;
+
+						_sendq = QueueT();
+						_sendq_bytes = 0;
+						_output_stream.clear();
+
+						// Wake up the runloop, which will report the failure from process_events.
+						_send_limit_exceeded = true;
+						::shutdown(file_descriptor(), SHUT_RDWR);
+
+						return false;
+
+					case SendLimitPolicy::BLOCK:
+						if (!wait_for_send_space(size)) {
+							_dropped_message_count += 1;
+
+							return false;
+						}
+				}
+			}
+
 			_sendq.push(msg);
+			_sendq_bytes += size;
+
+			_write_interest = true;
+
+			update_watermarks();
+
+			return true;
 		}
 
 		MessageClientSocket::QueueT & MessageClientSocket::received_messages ()
@@ -207,18 +649,16 @@ namespace Dream {
 			}
 		}
 
-		bool MessageClientSocket::update_receiver () {
+		bool MessageClientSocket::update_receiver (IOResult & result) {
 			//std::cout << __PRETTY_FUNCTION__ << std::endl;
-			// Default state is no message, so we read data
-			if (_receiver.receive_from_socket(this)) {
-				// We have received a complete message, put it on the receive queue.
-				_recvq.push(_receiver.message());
+			// Complete messages are put on the receive queue.
+			std::size_t count = _receiver.receive_from_socket(this, _recvq, result);
 
-				// Reset the message receiver.
-				_receiver.reset();
-
-				if (message_received_callback)
-					message_received_callback(this);
+			if (count > 0) {
+				if (message_received_callback) {
+					for (std::size_t i = 0; i < count; i += 1)
+						message_received_callback(this);
+				}
 
 				return true;
 			}
@@ -228,38 +668,74 @@ namespace Dream {
 			return false;
 		}
 
-		void MessageClientSocket::update_sender () {
-			// Do we have a message to send?
-			if (!_sender.has_message_to_send()) {
-				// No, no messages currently sending.
-				if (_sendq.size() > 0) {
-					//std::cout << __PRETTY_FUNCTION__ << ": Pushing message.." << std::endl;
-					// A message is queued to be sent, so lets start sending it.
-					_sender.reset(_sendq.front());
-					_sendq.pop();
-				}
+		void MessageClientSocket::append_message (Ref<Message> msg) {
+			DREAM_ASSERT(msg->is_valid());
+
+			const BufferT & packet = msg->packet();
+
+			if (_framing == MessageFraming::PACKED) {
+				_output_stream.append(packet.begin(), packet.size(), msg);
+			} else {
+				Byte header[Message::MAXIMUM_VARINT_HEADER_LENGTH];
+				std::size_t header_length = msg->encode_header(_framing, header);
+
+				_output_stream.append_copy(header, header_length);
+
+				if (msg->data_length() > 0)
+					_output_stream.append(packet.begin() + msg->header_length(), msg->data_length(), msg);
 			}
+		}
 
-			if (_sender.has_message_to_send()) {
-				// We are currently sending a message
-				if (_sender.send_via_socket(this)) {
-					//std::cout << __PRETTY_FUNCTION__ << ": Message sent successfully.." << std::endl;
-					// Message has beeen sent completely
-					_sender.reset();
-				} else {
-					//std::cout << __PRETTY_FUNCTION__ << ": Message partially sent.." << std::endl;
-					// Some part of message remains...
-					// We'll continue to send it next time.
-				}
+		void MessageClientSocket::update_sender (IOResult & result) {
+			// Gather all queued messages so that they are written together.
+			while (_sendq.size() > 0) {
+				append_message(_sendq.front());
+				_sendq.pop();
 			}
+
+			_sendq_bytes = 0;
+
+			// Any data which isn't written now will be written next time.
+			result = _output_stream.try_write_to(file_descriptor());
+
+			// Disarm until another message is queued.
+			if (_output_stream.empty())
+				_write_interest = false;
+
+			update_watermarks();
 		}
 
 		void MessageClientSocket::process_events(Events::Loop * event_loop, Events::Event events) {
+			if (_send_limit_exceeded) {
+				disconnected(event_loop, IOResult(IOStatus::FAILED, 0, ENOBUFS));
+
+				return;
+			}
+
+			IOResult result;
+
 			if (Events::READ_READY & events)
-				update_receiver();
+				update_receiver(result);
+
+			// Release messages which the kernel has finished sending. Completions are queued on the socket's error queue, which wakes it up.
+			if (_output_stream.pending_zero_copy_count())
+				_output_stream.reap_zero_copy_completions(file_descriptor());
+
+			// Idle sockets are always writable, so only do work when something is waiting to be sent.
+			if (Events::WRITE_READY & events && _write_interest && !result.is_disconnected())
+				update_sender(result);
+
+			if (result.is_disconnected())
+				disconnected(event_loop, result);
+		}
+
+		void MessageClientSocket::disconnected (Events::Loop * event_loop, const IOResult & result) {
+			if (disconnected_callback)
+				disconnected_callback(this, result);
 
-			if (Events::WRITE_READY & events)
-				update_sender();
+			// This may release the last reference to the socket, so it must be done last.
+			if (event_loop)
+				event_loop->stop_monitoring_file_descriptor(this);
 		}
 	}
 }
@@ -10,10 +10,13 @@
 #pragma once
 
 #include "Socket.hpp"
+#include "OutputStream.hpp"
 #include <Dream/Core/Endian.hpp>
 #include <Buffers/DynamicBuffer.hpp>
 
 #include <queue>
+#include <vector>
+#include <mutex>
 #include <cstring>
 
 namespace Dream {
@@ -21,12 +24,27 @@ namespace Dream {
 		typedef Buffers::DynamicBuffer BufferT;
 		
 		/// The message header contains the type and length of the message that has been sent or received.
-		struct alignas(32) MessageHeader {
+		/// The header is packed so that it costs only 6 bytes on the wire.
+#pragma pack(push, 1)
+		struct MessageHeader {
 			/// The length in bytes.
 			Core::Ordered<uint32_t> length;
 			/// The packet type.
 			Core::Ordered<uint16_t> packet_type;
 		};
+#pragma pack(pop)
+
+		static_assert(sizeof(MessageHeader) == 6, "MessageHeader must not be padded");
+
+		/// How the header of a message is encoded on the wire. Both ends of a connection must use the same framing.
+		enum class MessageFraming {
+			/// The MessageHeader is sent as is, followed by the data.
+			PACKED,
+			/// The length and packet type are sent as unsigned LEB128 varints, followed by the data. Small messages have a 2 byte header.
+			VARINT
+		};
+
+		class MessagePool;
 
 		/** A message that can be sent across the network.
 
@@ -37,12 +55,41 @@ namespace Dream {
 		 */
 		class Message : public Object {
 		protected:
-			BufferT _packet;
+			Shared<BufferT> _packet;
+
+			/// If the message was allocated from a pool, the packet buffer is returned to the pool when the message is destroyed.
+			Ref<MessagePool> _pool;
 
 		public:
+			/// Construct an empty message with a new packet buffer.
+			Message ();
+
+			/// Construct an empty message using the given packet buffer, which will be returned to the pool when the message is destroyed.
+			/// @sa MessagePool::allocate
+			Message (Ref<MessagePool> pool, Shared<BufferT> packet);
+
+			virtual ~Message ();
+
+			/// The maximum length of a varint encoded header: 5 bytes for the length and 3 bytes for the packet type.
+			static const std::size_t MAXIMUM_VARINT_HEADER_LENGTH = 8;
+
+			/// Returned by decode_varint_header if the data can never be decoded, e.g. a length which doesn't fit in 32 bits.
+			static const std::size_t MALFORMED_HEADER = ~(std::size_t)0;
+
 			/// The length of the header segment.
 			uint32_t header_length () const;
 
+			/// The length of the header when sent on the wire using the given framing.
+			std::size_t header_length (MessageFraming framing) const;
+
+			/// Encode the header as it is sent on the wire using the given framing. The buffer must have space for at least MAXIMUM_VARINT_HEADER_LENGTH bytes.
+			/// @returns the number of bytes written.
+			std::size_t encode_header (MessageFraming framing, Byte * buffer) const;
+
+			/// Decode a varint encoded header.
+			/// @returns the number of bytes consumed, 0 if more data is required, or MALFORMED_HEADER if the header is invalid.
+			static std::size_t decode_varint_header (const Byte * begin, const Byte * end, uint32_t & length, uint16_t & packet_type);
+
 			/// The length of the data segment.
 			uint32_t data_length () const;
 
@@ -72,11 +119,11 @@ namespace Dream {
 				offset += header_length();
 				std::size_t sz = sizeof(type_t);
 
-				if (offset + sz > _packet.size()) {
+				if (offset + sz > _packet->size()) {
 					return false;
 				}
 
-				std::memcpy(&s, _packet.begin() + offset, sz);
+				std::memcpy(&s, _packet->begin() + offset, sz);
 				
 				return true;
 			}
@@ -84,17 +131,58 @@ namespace Dream {
 			/// Write structured data into the message buffer.
 			template <typename type_t>
 			void insert (type_t & s) {
-				std::size_t offset = _packet.size();
+				std::size_t offset = _packet->size();
 				std::size_t sz = sizeof(type_t);
 
 				// Make room at the end
-				_packet.resize(offset + sz);
+				_packet->resize(offset + sz);
 
-				std::memcpy(&_packet[offset], &s, sz);
+				std::memcpy(&(*_packet)[offset], &s, sz);
 				update_size();
 			}
 		};
 
+		/** Recycles the packet buffers of messages which are no longer in use.
+
+		 Receiving a message typically requires allocating a packet buffer and growing it to fit the incoming data. A pool keeps the buffers of destroyed
+		 messages, along with their capacity, so that subsequent messages can reuse them. A pool may be shared between sockets, and messages may be released
+		 on any thread.
+
+		 */
+		class MessagePool : public Object {
+		protected:
+			mutable std::mutex _lock;
+			std::vector<Shared<BufferT>> _buffers;
+
+			std::size_t _maximum_count;
+			std::size_t _maximum_capacity;
+
+			std::size_t _hit_count = 0, _miss_count = 0;
+
+		public:
+			/// @param maximum_count the maximum number of buffers retained by the pool.
+			/// @param maximum_capacity buffers with more capacity than this are freed rather than retained.
+			MessagePool (std::size_t maximum_count = 64, std::size_t maximum_capacity = 1024*64);
+			virtual ~MessagePool ();
+
+			/// Allocate an empty message, reusing a packet buffer if one is available.
+			Ref<Message> allocate ();
+
+			/// Return a packet buffer to the pool. Called when a message allocated from this pool is destroyed.
+			void release (Shared<BufferT> packet);
+
+			/// The number of buffers currently retained by the pool.
+			std::size_t size () const;
+
+			/// The number of allocations which reused a buffer.
+			std::size_t hit_count () const;
+			/// The number of allocations which required a new buffer.
+			std::size_t miss_count () const;
+
+			/// The proportion of allocations which reused a buffer.
+			double hit_rate () const;
+		};
+
 		/** Sends a Message via a ClientSocket.
 
 		 This class will send a single message. Once it is done, it can be reset with another message to send.
@@ -105,9 +193,15 @@ namespace Dream {
 			Ref<Message> _message;
 			unsigned _offset;
 
+			MessageFraming _framing;
+
+			/// The header as it is sent on the wire, if it differs from the header stored in the message packet.
+			Byte _header[Message::MAXIMUM_VARINT_HEADER_LENGTH];
+			std::size_t _header_length;
+
 		public:
-			MessageSender (Ref<Message> msg);
-			MessageSender ();
+			MessageSender (Ref<Message> msg, MessageFraming framing = MessageFraming::PACKED);
+			MessageSender (MessageFraming framing = MessageFraming::PACKED);
 
 			/// Cancel sending the current message. Note: Resetting the message part way through will corrupt the connection if the remote end expects
 			/// a complete message. Therefore, a MessageSender should only be reset once a complete message has been sent.
@@ -116,6 +210,10 @@ namespace Dream {
 			/// Prepare to send another message.
 			void reset (Ref<Message> msg);
 
+			/// The framing used for subsequent messages.
+			void set_framing (MessageFraming framing) { _framing = framing; }
+			MessageFraming framing () const { return _framing; }
+
 			/// Returns true if a message is currently waiting to be sent or in progress.
 			bool has_message_to_send () const;
 
@@ -126,54 +224,136 @@ namespace Dream {
 			bool transmission_complete () const;
 		};
 
-		/** Receives a Message via a ClientSocket.
+		typedef std::queue<Ref<Message>> MessageQueueT;
+
+		/** Receives messages via a ClientSocket.
 
-		 This class will receive a single message. Once it is done, it returns true, so that it can be reset.
+		 Data is read from the socket in large chunks into a read-ahead buffer, and as many complete messages as are buffered are parsed out of it, so that
+		 many small messages cost a single system call. The data of messages larger than the read-ahead buffer is received directly into the message.
 
 		 */
 		class MessageReceiver {
 		protected:
 			Ref<Message> _message;
+			Ref<MessagePool> _message_pool;
+
+			MessageFraming _framing;
+
+			/// Data read from the socket, starting at _input_offset, which has not yet been parsed. Because partial data is moved into _message as soon as
+			/// its header is decoded, at most a partial header remains in the buffer between reads.
+			BufferT _input;
+			std::size_t _input_offset = 0;
+			std::size_t _read_ahead_size;
+
+			/// Decode a header from the given data into the message, advancing begin.
+			/// @returns false if more data is required, or if the header is malformed, in which case result is set to a protocol error.
+			bool decode_header (const Byte *& begin, const Byte * end, IOResult & result);
+
+			/// Move any unparsed data to the start of the read-ahead buffer.
+			void compact_input ();
+
+			/// Parse as many complete messages as possible out of the read-ahead buffer. If the input is malformed, result is set to a protocol error.
+			std::size_t parse_input (MessageQueueT & messages, IOResult & result);
 
 		public:
-			MessageReceiver ();
+			MessageReceiver (MessageFraming framing = MessageFraming::PACKED, std::size_t read_ahead_size = 1024*16);
+
+			/// The framing expected for subsequent messages.
+			void set_framing (MessageFraming framing) { _framing = framing; }
+			MessageFraming framing () const { return _framing; }
 
-			/// Resets the message.
-			/// This should be done when the receive_from_socket() method returns true.
+			/// Allocate subsequent messages from the given pool. If no pool is set, messages are allocated individually.
+			void set_message_pool (Ref<MessagePool> message_pool);
+			Ref<MessagePool> message_pool () const { return _message_pool; }
+
+			/// Discard the partial message, and start receiving a new one.
 			void reset ();
 
-			/// Retrieve the complete or partial message.
+			/// Retrieve the partial message.
 			Ref<Message> message ();
 
-			/// Read data from the socket to add to the incoming message.
-			/// @returns true when the message is complete.
-			bool receive_from_socket (ClientSocket * socket);
+			/// Read data from the socket and append any complete messages to the given queue. Throws if the connection was shut down or reset.
+			/// @returns the number of complete messages received.
+			std::size_t receive_from_socket (ClientSocket * socket, MessageQueueT & messages);
+
+			/// Read data from the socket and append any complete messages to the given queue. The outcome of reading from the socket is stored in result,
+			/// which fails with EPROTO if the data received can't be parsed.
+			/// @returns the number of complete messages received.
+			std::size_t receive_from_socket (ClientSocket * socket, MessageQueueT & messages, IOResult & result);
 		};
 
 // MARK: -
 // MARK: class MessageClientSocket
 
+		/// What MessageClientSocket::send_message does when queueing a message would exceed the send limit.
+		enum class SendLimitPolicy {
+			/// Discard the message.
+			DROP,
+			/// Discard everything which is queued and disconnect, reporting ENOBUFS to disconnected_callback.
+			DISCONNECT,
+			/// Write to the socket, waiting for it to become writable, until the message fits. This blocks the calling thread, and so the runloop
+			/// if it is called from there.
+			BLOCK,
+		};
+
 		/** Provides asynchronous message sending and retrival with good efficiency and reliability.
 
-		 This class contains two queues, a receive queue and send queue. These queues feed directly into an instance of both MessageSender and MessageReceiver.
-		 Messages in the queues will be sent and received in the background, and can be pushed and popped as needed.
+		 This class contains two queues, a receive queue and send queue. The receive queue is fed by a MessageReceiver. When the socket is ready for
+		 writing, all messages in the send queue are moved into an OutputStream and written together using as few writev calls as possible. Messages in
+		 the queues will be sent and received in the background, and can be pushed and popped as needed.
 
 		 It is expected that this class will provide the basis for any custom network APIs.
 
 		 */
 		class MessageClientSocket : public ClientSocket {
 		protected:
-			MessageSender _sender;
+			MessageFraming _framing = MessageFraming::PACKED;
 			MessageReceiver _receiver;
 
-			typedef std::queue<Ref<Message>> QueueT;
+			typedef MessageQueueT QueueT;
 			QueueT _recvq, _sendq;
 
-			/// Processes any outgoing messages.
-			void update_sender ();
+			/// Messages which are being sent. The stream retains each message until it has been written completely.
+			OutputStream _output_stream;
+
+			/// Whether the socket has data to write and is interested in WRITE_READY events. Armed by send_message() and disarmed once everything
+			/// has been written.
+			bool _write_interest = false;
+
+			/// The number of bytes in _sendq, as they will be sent on the wire.
+			std::size_t _sendq_bytes = 0;
+
+			std::size_t _low_watermark = 0, _high_watermark = 0;
+			bool _send_paused = false;
+
+			std::size_t _send_limit = 0;
+			SendLimitPolicy _send_limit_policy = SendLimitPolicy::DROP;
+			bool _send_limit_exceeded = false;
+			std::size_t _dropped_message_count = 0;
+
+			/// The number of bytes the message will occupy on the wire.
+			std::size_t wire_length (const Message * msg) const;
+
+			/// Pause or resume the producer as the queued bytes cross the watermarks.
+			void update_watermarks ();
 
-			/// @returns true when a complete message was received.
-			bool update_receiver ();
+			/// Write to the socket until size more bytes fit within the send limit.
+			/// @returns false if the socket failed before enough space was available.
+			bool wait_for_send_space (std::size_t size);
+
+			/// Append the header and data of a message to the output stream, according to the framing.
+			void append_message (Ref<Message> msg);
+
+			/// Processes any outgoing messages. The outcome of writing to the socket is stored in result.
+			void update_sender (IOResult & result);
+
+			/// The outcome of reading from the socket is stored in result.
+			/// @returns true when at least one complete message was received.
+			bool update_receiver (IOResult & result);
+
+			/// Called when the remote peer has closed or reset the connection, or some other error has occurred. Invokes disconnected_callback and
+			/// stops monitoring the socket.
+			virtual void disconnected (Events::Loop *, const IOResult & result);
 
 		public:
 			MessageClientSocket (const SocketHandleT & h, const Address & address);
@@ -181,17 +361,57 @@ namespace Dream {
 
 			virtual ~MessageClientSocket ();
 
-			/// Cancel all messages on the send queue.
+			/// Select how message headers are encoded on the wire. This should be done before any messages are sent or received, and must match the
+			/// framing used by the remote peer.
+			void set_framing (MessageFraming framing);
+			MessageFraming framing () const { return _framing; }
+
+			/// Incoming messages are allocated from this pool. By default, each socket has a small pool of its own, but a pool may be shared between
+			/// sockets on the same runloop.
+			void set_message_pool (Ref<MessagePool> message_pool);
+			Ref<MessagePool> message_pool () const { return _receiver.message_pool(); }
+
+			/// Send messages with at least this many bytes of data using MSG_ZEROCOPY, rather than copying them into the kernel. Each message is retained until
+			/// the kernel reports that the send has completed, so it must not be modified after being queued. Zero disables zero-copy. Returns false, leaving
+			/// zero-copy disabled, if the socket doesn't support it.
+			bool set_zero_copy_threshold (std::size_t threshold);
+			std::size_t zero_copy_threshold () const { return _output_stream.zero_copy_threshold(); }
+
+			/// The output stream, which provides zero-copy statistics.
+			const OutputStream & output_stream () const { return _output_stream; }
+
+			/// Cancel all messages on the send queue. Messages which have already started being written will still be sent.
 			void flush_send_queue ();
 
 			/// Remove any messages in the receive queue.
 			void flush_receive_queue ();
 
-			/// @returns true if there are currently messages to be sent or being sent.
+			/// @returns true if there are currently messages to be sent or being sent. Messages awaiting zero-copy completion have already been sent.
 			bool has_messages_to_send ();
 
-			/// Queues a message to be sent.
-			void send_message (Ref<Message> msg);
+			/// Queues a message to be sent, and arms write interest.
+			/// @returns false if the message was discarded because of the send limit.
+			bool send_message (Ref<Message> msg);
+
+			/// The number of bytes queued for sending, including messages which have been partially written.
+			std::size_t queued_bytes () const { return _sendq_bytes + _output_stream.queued_bytes(); }
+
+			/// Invoke send_paused_callback once at least high bytes are queued, and send_resumed_callback once the queue has drained to low bytes or
+			/// fewer. A high watermark of zero disables these callbacks.
+			void set_send_watermarks (std::size_t low, std::size_t high);
+
+			/// Whether the queue has reached the high watermark and not yet drained to the low watermark.
+			bool is_send_paused () const { return _send_paused; }
+
+			/// Apply the policy when queueing a message would take the queued bytes past limit. A message is always accepted when nothing else is
+			/// queued, so that a single large message can still be sent. A limit of zero (the default) is unbounded.
+			void set_send_limit (std::size_t limit, SendLimitPolicy policy);
+
+			/// The number of messages discarded because of the send limit.
+			std::size_t dropped_message_count () const { return _dropped_message_count; }
+
+			/// Whether WRITE_READY events will be acted upon. When false, WRITE_READY events are ignored without touching the send queue.
+			bool write_interest () const { return _write_interest; }
 
 			/// Returns the queue containing incoming messages
 			QueueT & received_messages ();
@@ -203,8 +423,14 @@ namespace Dream {
 			/// Calls update_sender() and update_receiver() as needed.
 			virtual void process_events (Events::Loop *, Events::Event);
 
-			/// Delegate function to handle incoming messages. Called when a message is received.
+			/// Delegate function to handle incoming messages. Called once for each message received.
 			std::function<void (MessageClientSocket *)> message_received_callback;
+
+			/// Delegate functions called when the send queue reaches the high watermark and drains to the low watermark, respectively.
+			std::function<void (MessageClientSocket *)> send_paused_callback, send_resumed_callback;
+
+			/// Delegate function called when the connection has been closed, reset, or has otherwise failed.
+			std::function<void (MessageClientSocket *, const IOResult &)> disconnected_callback;
 		};
 	}
 }
@@ -0,0 +1,204 @@
+//
+//  MessageDatagram.cpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include "MessageDatagram.hpp"
+
+#include <cstring>
+
+namespace Dream
+{
+	namespace Network
+	{
+		MessageDatagramSocket::MessageDatagramSocket (const Address & local_address, std::size_t batch_size, std::size_t maximum_datagram_size) : DatagramSocket(local_address, batch_size, maximum_datagram_size), _message_pool(new MessagePool(batch_size)), _packing(maximum_datagram_size)
+		{
+		}
+		
+		MessageDatagramSocket::MessageDatagramSocket (AddressFamily address_family, std::size_t batch_size, std::size_t maximum_datagram_size) : DatagramSocket(address_family, batch_size, maximum_datagram_size), _message_pool(new MessagePool(batch_size)), _packing(maximum_datagram_size)
+		{
+		}
+		
+		MessageDatagramSocket::~MessageDatagramSocket ()
+		{
+		}
+		
+		bool MessageDatagramSocket::send_message (Ref<Message> msg, const Address & destination)
+		{
+			DREAM_ASSERT(msg->is_valid());
+			
+			std::size_t header_length = msg->header_length(_framing);
+			std::size_t size = header_length + msg->data_length();
+			
+			if (size > maximum_datagram_size())
+				return false;
+			
+			// Start a new datagram if this one is going elsewhere, or the message doesn't fit.
+			if (_packing_size > 0 && (_packing_size + size > maximum_datagram_size() || _packing_destination != destination))
+				seal_datagram();
+			
+			if (_packing_size == 0)
+				_packing_destination = destination;
+			
+			Byte * buffer = &_packing[_packing_size];
+			
+			// The encoded header is never longer than the data written, even for VARINT framing.
+			msg->encode_header(_framing, buffer);
+			std::memcpy(buffer + header_length, msg->packet().begin() + msg->header_length(), msg->data_length());
+			
+			_packing_size += size;
+			_packed_message_count += 1;
+			
+			return true;
+		}
+		
+		bool MessageDatagramSocket::seal_datagram ()
+		{
+			if (_packing_size == 0)
+				return true;
+			
+			std::size_t size = _packing_size;
+			_packing_size = 0;
+			
+			_packed_datagram_count += 1;
+			
+			if (queue(_packing.data(), size, _packing_destination))
+				return true;
+			
+			// The slab is full, so make room by sending what is already queued.
+			try_flush();
+			
+			if (queue(_packing.data(), size, _packing_destination))
+				return true;
+			
+			_dropped_datagram_count += 1;
+			
+			return false;
+		}
+		
+		std::size_t MessageDatagramSocket::flush_messages ()
+		{
+			return try_flush_messages().value("sendmmsg");
+		}
+		
+		IOResult MessageDatagramSocket::try_flush_messages ()
+		{
+			seal_datagram();
+			
+			return try_flush();
+		}
+		
+		Ref<Message> MessageDatagramSocket::pop ()
+		{
+			Address sender;
+			
+			return pop(sender);
+		}
+		
+		Ref<Message> MessageDatagramSocket::pop (Address & sender)
+		{
+			if (_recvq.empty())
+				return nullptr;
+			
+			ReceivedMessage & front = _recvq.front();
+			Ref<Message> message = front.message;
+			sender = front.sender;
+			
+			_recvq.pop();
+			
+			return message;
+		}
+		
+		std::size_t MessageDatagramSocket::parse_datagram (const Datagram & datagram)
+		{
+			const Byte * begin = datagram.data, * end = datagram.data + datagram.size;
+			std::size_t count = 0;
+			
+			while (begin < end) {
+				uint32_t length = 0;
+				uint16_t packet_type = 0;
+				
+				if (_framing == MessageFraming::VARINT) {
+					std::size_t header_length = Message::decode_varint_header(begin, end, length, packet_type);
+					
+					if (header_length == 0 || header_length == Message::MALFORMED_HEADER)
+						break;
+					
+					begin += header_length;
+				} else {
+					if ((std::size_t)(end - begin) < sizeof(MessageHeader))
+						break;
+					
+					MessageHeader header;
+					std::memcpy(&header, begin, sizeof(header));
+					
+					length = header.length;
+					packet_type = header.packet_type;
+					
+					begin += sizeof(header);
+				}
+				
+				// A message never spans datagrams.
+				if (length > (std::size_t)(end - begin))
+					break;
+				
+				Ref<Message> message = _message_pool->allocate();
+				
+				message->reset_header();
+				message->header()->length = length;
+				message->header()->packet_type = packet_type;
+				
+				BufferT & packet = message->packet();
+				std::size_t offset = packet.size();
+				
+				packet.resize(offset + length);
+				
+				if (length > 0)
+					std::memcpy(&packet[offset], begin, length);
+				
+				begin += length;
+				
+				_recvq.push({message, datagram.address});
+				
+				count += 1;
+			}
+			
+			if (begin != end || datagram.truncated)
+				_malformed_datagram_count += 1;
+			
+			return count;
+		}
+		
+		void MessageDatagramSocket::process_events (Events::Loop * event_loop, Events::Event events)
+		{
+			if (events & Events::READ_READY) {
+				for (std::size_t batch = 0; receive_budget == 0 || batch < receive_budget; batch += 1) {
+					IOResult result = try_receive();
+					
+					if (!result.is_ok() || result.size == 0)
+						break;
+					
+					std::size_t count = 0;
+					
+					for (std::size_t i = 0; i < received_count(); i += 1)
+						count += parse_datagram(received_datagram(i));
+					
+					if (message_received_callback) {
+						for (std::size_t i = 0; i < count; i += 1)
+							message_received_callback(this);
+					}
+					
+					// A partial batch means there is nothing more waiting.
+					if (!receive_offload() && result.size < batch_size())
+						break;
+				}
+			}
+			
+			if ((events & Events::WRITE_READY) && (queued_count() > 0 || _packing_size > 0))
+				try_flush_messages();
+		}
+	}
+}
@@ -0,0 +1,112 @@
+//
+//  MessageDatagram.hpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#pragma once
+
+#include "Datagram.hpp"
+#include "Message.hpp"
+
+namespace Dream
+{
+	namespace Network
+	{
+		/** Sends and receives whole messages over datagrams, avoiding the head-of-line blocking of a stream.
+		
+		 Each datagram carries one or more complete messages, framed exactly as MessageClientSocket frames them on a stream. Messages sent to the same destination are packed together until the next would exceed the maximum datagram size, and the packed datagrams are sent in batches by flush_messages(). Received messages are delivered into a queue, as with MessageClientSocket.
+		
+		 Delivery is unreliable and unordered: a lost datagram loses every message packed into it. A datagram which can't be parsed completely is counted as malformed, and only the messages preceding the fault are delivered.
+		 */
+		class MessageDatagramSocket : public DatagramSocket
+		{
+		public:
+			/// The largest payload which fits in an unfragmented IPv4 datagram on a typical 1500 byte MTU.
+			static const std::size_t DEFAULT_MAXIMUM_DATAGRAM_SIZE = 1472;
+			
+			/// Create a socket bound to the given local address.
+			MessageDatagramSocket (const Address & local_address, std::size_t batch_size = 64, std::size_t maximum_datagram_size = DEFAULT_MAXIMUM_DATAGRAM_SIZE);
+			
+			/// Create an unbound socket of the given family, suitable for sending.
+			MessageDatagramSocket (AddressFamily address_family, std::size_t batch_size = 64, std::size_t maximum_datagram_size = DEFAULT_MAXIMUM_DATAGRAM_SIZE);
+			
+			virtual ~MessageDatagramSocket ();
+			
+			/// Select how message headers are encoded. Both ends must use the same framing. VARINT framing packs more small messages into each datagram.
+			void set_framing (MessageFraming framing) { _framing = framing; }
+			MessageFraming framing () const { return _framing; }
+			
+			/// Incoming messages are allocated from this pool. By default, each socket has a small pool of its own.
+			void set_message_pool (Ref<MessagePool> message_pool) { _message_pool = message_pool; }
+			Ref<MessagePool> message_pool () const { return _message_pool; }
+			
+			/// Pack a message into the datagram being built for the destination. The message is copied, so it may be reused immediately.
+			/// @returns false if the message can't fit in a single datagram.
+			bool send_message (Ref<Message> msg, const Address & destination);
+			
+			/// Queue the datagram being built, and send all queued datagrams.
+			/// @returns the number of datagrams sent.
+			std::size_t flush_messages ();
+			
+			/// As flush_messages(), but reporting would-block and errors as a result rather than throwing.
+			IOResult try_flush_messages ();
+			
+			/// An incoming message, and the address of the socket which sent it.
+			struct ReceivedMessage
+			{
+				Ref<Message> message;
+				Address sender;
+			};
+			
+			typedef std::queue<ReceivedMessage> ReceivedQueueT;
+			
+			/// Returns the queue containing incoming messages. Each message is queued with its sender, so the two can't be separated by popping the queue directly.
+			ReceivedQueueT & received_messages () { return _recvq; }
+			const ReceivedQueueT & received_messages () const { return _recvq; }
+			
+			/// Pop the front message off the receive queue and return it, otherwise NULL.
+			Ref<Message> pop ();
+			Ref<Message> pop (Address & sender);
+			
+			/// The number of messages packed into datagrams, and the number of datagrams they were packed into.
+			std::size_t packed_message_count () const { return _packed_message_count; }
+			std::size_t packed_datagram_count () const { return _packed_datagram_count; }
+			
+			/// The number of datagrams which were discarded because the send slab was full and the socket would block.
+			std::size_t dropped_datagram_count () const { return _dropped_datagram_count; }
+			
+			/// The number of received datagrams which were truncated or contained an incomplete message.
+			std::size_t malformed_datagram_count () const { return _malformed_datagram_count; }
+			
+			/// Receives messages when readable, and sends queued datagrams when writable.
+			virtual void process_events (Events::Loop *, Events::Event);
+			
+			/// Delegate function to handle incoming messages. Called once for each message received.
+			std::function<void (MessageDatagramSocket *)> message_received_callback;
+		
+		protected:
+			MessageFraming _framing = MessageFraming::PACKED;
+			Ref<MessagePool> _message_pool;
+			
+			ReceivedQueueT _recvq;
+			
+			/// The datagram being built, and its destination.
+			std::vector<Byte> _packing;
+			std::size_t _packing_size = 0;
+			Address _packing_destination;
+			
+			std::size_t _packed_message_count = 0, _packed_datagram_count = 0, _dropped_datagram_count = 0, _malformed_datagram_count = 0;
+			
+			/// Move the datagram being built into the send slab, flushing the slab first if it is full.
+			/// @returns false if the datagram was dropped.
+			bool seal_datagram ();
+			
+			/// Parse the messages in a received datagram onto the receive queue.
+			/// @returns the number of messages received.
+			std::size_t parse_datagram (const Datagram & datagram);
+		};
+	}
+}
@@ -9,6 +9,10 @@
 
 #include "Network.hpp"
 
+#include <Dream/Core/System.hpp>
+
+#include <errno.h>
+
 namespace Dream
 {
 	namespace Network
@@ -24,5 +28,53 @@ namespace Dream
 		ConnectionShutdown::ConnectionShutdown (const std::string & what) : _what(what)
 		{
 		}
+
+		IOResult IOResult::from_system_call (ssize_t result)
+		{
+			if (result > 0)
+				return IOResult(IOStatus::OK, result);
+
+			if (result == 0)
+				return IOResult(IOStatus::CLOSED);
+
+			switch (errno) {
+				case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+				case EWOULDBLOCK:
+#endif
+				case EINTR:
+					return IOResult(IOStatus::WOULD_BLOCK);
+
+				case ECONNRESET:
+				case EPIPE:
+					return IOResult(IOStatus::RESET, 0, errno);
+
+				default:
+					return IOResult(IOStatus::FAILED, 0, errno);
+			}
+		}
+
+		std::size_t IOResult::value (const char * what) const
+		{
+			switch (status) {
+				case IOStatus::OK:
+					return size;
+
+				case IOStatus::WOULD_BLOCK:
+					return 0;
+
+				case IOStatus::CLOSED:
+					throw ConnectionShutdown(what);
+
+				case IOStatus::RESET:
+					throw ConnectionResetByPeer(what);
+
+				case IOStatus::FAILED:
+					errno = error;
+					Core::SystemError::check(what);
+			}
+
+			return 0;
+		}
 	}
 }
@@ -18,6 +18,8 @@
 #include <exception>
 #include <stdexcept>
 
+#include <sys/types.h>
+
 namespace Dream {
 	/// Network related functions for clients and servers.
 	namespace Network {
@@ -53,5 +55,48 @@ namespace Dream {
 		public:
 			explicit ConnectionShutdown (const std::string & what);
 		};
+
+		/// The outcome of a non-throwing read or write operation.
+		enum class IOStatus {
+			/// Some data was transferred.
+			OK,
+			/// No data could be transferred without blocking. Try again when the file descriptor is ready.
+			WOULD_BLOCK,
+			/// The remote peer has shut down the connection in an orderly way.
+			CLOSED,
+			/// The connection was reset by the remote peer.
+			RESET,
+			/// Some other error occurred. The error code is available.
+			FAILED
+		};
+
+		/** The result of a non-throwing read or write operation.
+
+		 Peer disconnection is a normal event for a busy server, so the non-throwing APIs report it as a value rather than unwinding the stack. The
+		 throwing APIs are implemented in terms of these using value().
+
+		 */
+		struct IOResult {
+			IOStatus status;
+			/// The number of bytes transferred, if the status is OK.
+			std::size_t size;
+			/// The value of errno, if the status is FAILED.
+			int error;
+
+			IOResult () : status(IOStatus::OK), size(0), error(0) {}
+			IOResult (IOStatus status_, std::size_t size_ = 0, int error_ = 0) : status(status_), size(size_), error(error_) {}
+
+			/// Interpret the return value of a system call such as recv, send or writev, using errno if it failed.
+			static IOResult from_system_call (ssize_t result);
+
+			bool is_ok () const { return status == IOStatus::OK; }
+			bool would_block () const { return status == IOStatus::WOULD_BLOCK; }
+
+			/// Whether the connection can no longer be used.
+			bool is_disconnected () const { return status == IOStatus::CLOSED || status == IOStatus::RESET || status == IOStatus::FAILED; }
+
+			/// Returns the number of bytes transferred, or throws ConnectionShutdown, ConnectionResetByPeer or SystemError according to the status.
+			std::size_t value (const char * what) const;
+		};
 	}
 }
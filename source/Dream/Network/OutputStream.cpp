@@ -10,7 +10,21 @@
 
 #include <sys/types.h>
 #include <sys/uio.h>
+#include <limits.h>
+#include <sys/socket.h>
 #include <unistd.h>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <sys/sendfile.h>
+#endif
+
+#if defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define DREAM_NETWORK_ZERO_COPY
+#endif
 
 namespace Dream
 {
@@ -24,6 +38,130 @@ namespace Dream
 		{
 		}
 		
+		const Byte * OutputStream::Segment::begin() const
+		{
+			if (buffer)
+				return buffer->begin();
+			else if (data)
+				return data;
+			else
+				return inline_data;
+		}
+		
+		std::size_t OutputStream::Segment::length() const
+		{
+			if (buffer)
+				return buffer->size();
+			else
+				return size;
+		}
+		
+		void OutputStream::push_back(const Segment & segment)
+		{
+			_queued_bytes += segment.length();
+			
+			_segments.push_back(segment);
+		}
+		
+		void OutputStream::stage(const Byte * data, std::size_t size)
+		{
+			if (size == 0)
+				return;
+			
+			// Nothing refers to the chunk once everything has been written, so it can be reused from the start.
+			if (_staging_chunk && _segments.empty() && _zero_copy_pending.empty())
+				_staging_chunk->used = 0;
+			
+			if (!_staging_chunk || _staging_chunk->used + size > STAGING_CHUNK_SIZE)
+				_staging_chunk = new StagingChunk;
+			
+			Byte * destination = _staging_chunk->data + _staging_chunk->used;
+			std::memcpy(destination, data, size);
+			
+			_staging_chunk->used += size;
+			_coalesced_bytes += size;
+			
+			if (!_segments.empty()) {
+				Segment & last = _segments.back();
+				
+				if (last.owner.get() == _staging_chunk.get() && last.data + last.size == destination) {
+					last.size += size;
+					_queued_bytes += size;
+					
+					return;
+				}
+			}
+			
+			Segment segment;
+			segment.owner = _staging_chunk;
+			segment.data = destination;
+			segment.size = size;
+			
+			push_back(segment);
+		}
+		
+		void OutputStream::append(Shared<Buffer> buffer)
+		{
+			if (buffer->size() < _coalesce_threshold)
+				return stage(buffer->begin(), buffer->size());
+			
+			Segment segment;
+			segment.buffer = buffer;
+			
+			_referenced_bytes += buffer->size();
+			
+			push_back(segment);
+		}
+		
+		void OutputStream::append(const Byte * data, std::size_t size, Ref<Object> owner)
+		{
+			if (size < _coalesce_threshold)
+				return stage(data, size);
+			
+			Segment segment;
+			segment.owner = owner;
+			segment.data = data;
+			segment.size = size;
+			
+			_referenced_bytes += size;
+			
+			push_back(segment);
+		}
+		
+		void OutputStream::append_copy(const Byte * data, std::size_t size)
+		{
+			DREAM_ASSERT(size <= INLINE_SIZE);
+			
+			if (size < _coalesce_threshold)
+				return stage(data, size);
+			
+			Segment segment;
+			std::memcpy(segment.inline_data, data, size);
+			segment.size = size;
+			
+			push_back(segment);
+		}
+		
+		void OutputStream::append_file(FileDescriptor file_descriptor, off_t offset, std::size_t length, Ref<Object> owner)
+		{
+			DREAM_ASSERT(file_descriptor != -1);
+			
+			Segment segment;
+			segment.owner = owner;
+			segment.file = file_descriptor;
+			segment.file_offset = offset;
+			segment.size = length;
+			
+			push_back(segment);
+		}
+		
+		void OutputStream::clear()
+		{
+			_segments.clear();
+			_offset = 0;
+			_queued_bytes = 0;
+		}
+		
 		inline void * iov_base_pointer(const Byte * base)
 		{
 			return const_cast<void *>(
@@ -33,49 +171,234 @@ namespace Dream
 		
 		std::size_t OutputStream::write_to(FileDescriptor file_descriptor)
 		{
-			// If there is nothing to write, do nothing!
-			if (_buffers.empty())
-				return 0;
+			return try_write_to(file_descriptor).value("write");
+		}
+		
+		void OutputStream::consume(std::size_t written)
+		{
+			_queued_bytes -= written;
+			
+			while (!_segments.empty()) {
+				std::size_t remaining = _segments.front().length() - _offset;
+				
+				// Did the entire buffer get written?
+				if (written >= remaining) {
+					// If so, we remove it.
+					written -= remaining;
+					_segments.pop_front();
+					_offset = 0;
+				} else {
+					// Otherwise, we record that it was only partially written.
+					_offset += written;
+					
+					break;
+				}
+			}
+		}
+		
+		IOResult OutputStream::try_write_file(FileDescriptor file_descriptor)
+		{
+			const Segment & segment = _segments.front();
 			
-			struct iovec iov[_buffers.size()];
+			off_t offset = segment.file_offset + _offset;
+			std::size_t remaining = segment.length() - _offset;
 			
-			// The first write buffer requires special attention due to _offset.
-			iov[0].iov_base = iov_base_pointer(_buffers[0]->begin() + _offset);
-			iov[0].iov_len = _buffers[0]->size() - _offset;
+			IOResult result;
 			
-			for (std::size_t i = 1; i < _buffers.size(); i += 1) {
-				iov[i].iov_base = iov_base_pointer(_buffers[i]->begin());
-				iov[i].iov_len = _buffers[i]->size();
+#ifdef __linux__
+			result = IOResult::from_system_call(::sendfile(file_descriptor, segment.file, &offset, remaining));
+			
+			// Not every kind of file can be used with sendfile, in which case fall back to copying through user space.
+			if (result.status == IOStatus::FAILED && (result.error == EINVAL || result.error == ENOSYS))
+#endif
+			{
+				Byte buffer[1024*16];
+				
+				auto read_result = IOResult::from_system_call(::pread(segment.file, buffer, std::min(remaining, sizeof(buffer)), offset));
+				
+				if (!read_result.is_ok())
+					result = read_result;
+				else
+					result = IOResult::from_system_call(::write(file_descriptor, buffer, read_result.size));
+			}
+			
+			// The file was shorter than the range which was appended.
+			if (result.status == IOStatus::CLOSED)
+				return IOResult(IOStatus::FAILED, 0, EIO);
+			
+			if (result.is_ok())
+				consume(result.size);
+			
+			return result;
+		}
+		
+		IOResult OutputStream::try_write_zero_copy(FileDescriptor file_descriptor)
+		{
+#ifdef DREAM_NETWORK_ZERO_COPY
+			const Segment & segment = _segments.front();
+			
+			struct iovec iov;
+			iov.iov_base = iov_base_pointer(segment.begin() + _offset);
+			iov.iov_len = segment.length() - _offset;
+			
+			struct msghdr message;
+			std::memset(&message, 0, sizeof(message));
+			message.msg_iov = &iov;
+			message.msg_iovlen = 1;
+			
+			auto result = IOResult::from_system_call(::sendmsg(file_descriptor, &message, MSG_ZEROCOPY));
+			
+			// Once the per-socket limit of pinned memory is reached, the kernel refuses zero-copy sends, so send the data normally instead.
+			if (result.status == IOStatus::FAILED && result.error == ENOBUFS)
+				result = IOResult::from_system_call(::send(file_descriptor, iov.iov_base, iov.iov_len, 0));
+			else if (result.is_ok() && result.size > 0) {
+				// The kernel may still be reading from the segment, so it must be retained until the send is completed, even if it was only partially written.
+				_zero_copy_pending.push_back({_zero_copy_sequence, segment});
+				_zero_copy_sequence += 1;
+				_zero_copy_count += 1;
 			}
 			
-			auto result = ::writev(file_descriptor, iov, _buffers.size());
+			if (result.is_ok())
+				consume(result.size);
+			
+			return result;
+#else
+			return IOResult(IOStatus::FAILED, 0, EOPNOTSUPP);
+#endif
+		}
+		
+		std::size_t OutputStream::reap_zero_copy_completions(FileDescriptor file_descriptor)
+		{
+			std::size_t completed = 0;
 			
-			if (result > 0) {
-				auto written = result;
+#ifdef DREAM_NETWORK_ZERO_COPY
+			while (!_zero_copy_pending.empty()) {
+				char control[128];
 				
-				for (std::size_t i = 0; i < _buffers.size(); i += 1) {
-					auto buffer_size = iov[i].iov_len;
+				struct msghdr message;
+				std::memset(&message, 0, sizeof(message));
+				message.msg_control = control;
+				message.msg_controllen = sizeof(control);
+				
+				if (::recvmsg(file_descriptor, &message, MSG_ERRQUEUE) == -1)
+					break;
+				
+				for (struct cmsghdr * header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+					if (!((header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR) || (header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR)))
+						continue;
 					
-					// Did the entire buffer get written?
-					if (written > buffer_size) {
-						// If so, we remove it.
-						written -= buffer_size;
-						_buffers.pop_front();
-					} else {
-						// Otherwise, we record that it was only partially written.
-						if (i == 0)
-							// Need to handle first buffer carefully.
-							_offset += written;
-						else
-							_offset = written;
-						
-						break;
+					struct sock_extended_err error;
+					std::memcpy(&error, CMSG_DATA(header), sizeof(error));
+					
+					if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY || error.ee_errno != 0)
+						continue;
+					
+					// The notification covers the inclusive range of sends [ee_info, ee_data], which may wrap around.
+					std::uint32_t first = error.ee_info, last = error.ee_data;
+					std::uint32_t count = last - first + 1;
+					
+					if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+						_zero_copy_copied_count += count;
+					
+					for (auto pending = _zero_copy_pending.begin(); pending != _zero_copy_pending.end();) {
+						if ((std::uint32_t)(pending->sequence - first) < count) {
+							pending = _zero_copy_pending.erase(pending);
+							completed += 1;
+						} else {
+							++pending;
+						}
 					}
 				}
 			}
+#endif
+			
+			return completed;
+		}
+		
+		// The kernel rejects writev with more than IOV_MAX vectors.
+#ifdef IOV_MAX
+		static const std::size_t MAXIMUM_BATCH_COUNT = IOV_MAX;
+#else
+		static const std::size_t MAXIMUM_BATCH_COUNT = 1024;
+#endif
+		
+		bool OutputStream::is_zero_copy_candidate(const Segment & segment) const
+		{
+			return _zero_copy_threshold && segment.length() >= _zero_copy_threshold && (segment.buffer || segment.owner);
+		}
+		
+		IOResult OutputStream::write_batch(FileDescriptor file_descriptor, std::size_t & expected)
+		{
+			expected = _segments.front().length() - _offset;
+			
+			if (_segments.front().is_file())
+				return try_write_file(file_descriptor);
+			
+#ifdef DREAM_NETWORK_ZERO_COPY
+			// Large segments are sent by themselves, so that smaller segments around them are still copied as usual.
+			if (is_zero_copy_candidate(_segments.front()) && expected >= _zero_copy_threshold)
+				return try_write_zero_copy(file_descriptor);
+#endif
+			
+			// Shared by all streams on the same thread, so that the batch is neither allocated per write nor sized by the number of segments.
+			static thread_local struct iovec iov[MAXIMUM_BATCH_COUNT];
+			
+			// The first write buffer requires special attention due to _offset.
+			iov[0].iov_base = iov_base_pointer(_segments[0].begin() + _offset);
+			iov[0].iov_len = expected;
+			
+			std::size_t count = 1, limit = std::min(_segments.size(), MAXIMUM_BATCH_COUNT);
+			
+			for (; count < limit; count += 1) {
+				const Segment & segment = _segments[count];
+				
+				// Stop before the next file range or large segment, so that it is sent without copying.
+				if (segment.is_file() || is_zero_copy_candidate(segment))
+					break;
+				
+				iov[count].iov_base = iov_base_pointer(segment.begin());
+				iov[count].iov_len = segment.length();
+				
+				expected += segment.length();
+			}
+			
+			auto result = IOResult::from_system_call(::writev(file_descriptor, iov, count));
+			
+			// Writing nothing is not a shutdown.
+			if (result.status == IOStatus::CLOSED)
+				result = IOResult(IOStatus::OK, 0);
+			
+			if (result.is_ok())
+				consume(result.size);
 			
-			// How many bytes were written.
 			return result;
 		}
+		
+		IOResult OutputStream::try_write_to(FileDescriptor file_descriptor)
+		{
+			std::size_t total = 0;
+			
+			while (!_segments.empty()) {
+				std::size_t expected = 0;
+				IOResult result = write_batch(file_descriptor, expected);
+				
+				if (!result.is_ok()) {
+					// Data written by earlier batches is reported, and the would-block will be seen again next time.
+					if (result.status == IOStatus::WOULD_BLOCK && total > 0)
+						break;
+					
+					return result;
+				}
+				
+				total += result.size;
+				
+				// A short write means the socket buffer is full.
+				if (result.size < expected)
+					break;
+			}
+			
+			// How many bytes were written.
+			return IOResult(IOStatus::OK, total);
+		}
 	}
 }
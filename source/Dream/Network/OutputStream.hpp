@@ -9,6 +9,7 @@
 #pragma once
 
 #include <deque>
+#include <cstdint>
 
 #include "Network.hpp"
 
@@ -23,21 +24,135 @@ namespace Dream
 		class OutputStream
 		{
 		public:
+			// Data up to this size can be copied into a segment rather than referenced.
+			static const std::size_t INLINE_SIZE = 16;
+			
+			// The size of each staging chunk which small segments are coalesced into.
+			static const std::size_t STAGING_CHUNK_SIZE = 1024*16;
+			
 			OutputStream();
 			virtual ~OutputStream();
 			
 			// Append a buffer for writing.
-			void append(Shared<Buffer> buffer)
-			{
-				_buffers.push_back(buffer);
-			}
+			void append(Shared<Buffer> buffer);
+			
+			// Append size bytes of data for writing. The owner is retained until the data has been written, and must keep the data valid until then.
+			void append(const Byte * data, std::size_t size, Ref<Object> owner);
+			
+			// Append a copy of a small amount of data (at most INLINE_SIZE bytes) for writing.
+			void append_copy(const Byte * data, std::size_t size);
+			
+			// Append length bytes of the file, starting at offset, for writing. The data is copied from the file to the socket by the kernel using sendfile where possible, in order with the surrounding segments. The owner is retained until the range has been written, and must keep the file descriptor open until then.
+			void append_file(FileDescriptor file_descriptor, off_t offset, std::size_t length, Ref<Object> owner = nullptr);
+			
+			// Segments smaller than this are copied into a contiguous staging chunk, merging adjacent small segments into a single iovec, rather than being referenced. Zero disables coalescing.
+			void set_coalesce_threshold(std::size_t threshold) {DREAM_ASSERT(threshold <= STAGING_CHUNK_SIZE); _coalesce_threshold = threshold;}
+			std::size_t coalesce_threshold() const {return _coalesce_threshold;}
+			
+			// The total number of bytes which were copied into staging chunks, and which were appended by reference.
+			std::size_t coalesced_bytes() const {return _coalesced_bytes;}
+			std::size_t referenced_bytes() const {return _referenced_bytes;}
 			
+			// Whether there is any data waiting to be written.
+			bool empty() const {return _segments.empty();}
+			
+			// The number of bytes waiting to be written, including file ranges.
+			std::size_t queued_bytes() const {return _queued_bytes;}
+			
+			// Discard all data waiting to be written, including any partially written segment.
+			void clear();
+			
+			// Write as many segments as possible, gathering buffers into batches of at most IOV_MAX for writev, until everything is written or the file descriptor would block.
+			// @returns the number of bytes written, or 0 if the file descriptor would block.
 			std::size_t write_to(FileDescriptor file_descriptor);
 			
+			// Write as many segments as possible, reporting would-block, shutdown and reset as a result rather than throwing.
+			IOResult try_write_to(FileDescriptor file_descriptor);
+			
+			// Segments of at least this size are sent with MSG_ZEROCOPY, and retained until the kernel reports that it no longer references them. Zero (the default) disables zero-copy. The socket must have SO_ZEROCOPY enabled, see Socket::set_zero_copy.
+			void set_zero_copy_threshold(std::size_t threshold) {_zero_copy_threshold = threshold;}
+			std::size_t zero_copy_threshold() const {return _zero_copy_threshold;}
+			
+			// Read completion notifications from the socket's error queue, releasing segments which the kernel no longer references.
+			// @returns the number of zero-copy sends which were completed.
+			std::size_t reap_zero_copy_completions(FileDescriptor file_descriptor);
+			
+			// The number of zero-copy sends which the kernel has not yet completed. The stream should not be destroyed while the socket is open and sends are pending.
+			std::size_t pending_zero_copy_count() const {return _zero_copy_pending.size();}
+			
+			// The total number of zero-copy sends, and how many of those the kernel completed by copying the data anyway (e.g. over loopback).
+			std::size_t zero_copy_count() const {return _zero_copy_count;}
+			std::size_t zero_copy_copied_count() const {return _zero_copy_copied_count;}
+			
 		private:
-			std::deque<Shared<Buffer>> _buffers;
+			struct Segment
+			{
+				Shared<Buffer> buffer;
+				Ref<Object> owner;
+				
+				const Byte * data = nullptr;
+				std::size_t size = 0;
+				
+				// A range of a file, rather than data in memory.
+				FileDescriptor file = -1;
+				off_t file_offset = 0;
+				
+				Byte inline_data[INLINE_SIZE];
+				
+				bool is_file() const {return file != -1;}
+				
+				const Byte * begin() const;
+				std::size_t length() const;
+			};
+			
+			std::deque<Segment> _segments;
 			std::size_t _offset = 0;
+			std::size_t _queued_bytes = 0;
+			
+			void push_back(const Segment & segment);
+			
+			struct StagingChunk : public Object
+			{
+				std::size_t used = 0;
+				Byte data[STAGING_CHUNK_SIZE];
+			};
+			
+			// Small segments are copied into the current chunk, which is reused once nothing refers to it.
+			Ref<StagingChunk> _staging_chunk;
+			std::size_t _coalesce_threshold = 256;
+			std::size_t _coalesced_bytes = 0, _referenced_bytes = 0;
+			
+			// Copy the data into the staging chunk, extending the last segment if it is adjacent.
+			void stage(const Byte * data, std::size_t size);
+			
+			// Remove size bytes from the front of the stream, which have been written.
+			void consume(std::size_t size);
+			
+			// Write one batch from the front of the stream: a file range, a zero-copy segment, or up to IOV_MAX buffers. Sets expected to the number of bytes attempted.
+			IOResult write_batch(FileDescriptor file_descriptor, std::size_t & expected);
+			
+			// Whether the segment is large enough to send using MSG_ZEROCOPY. Only segments backed by a buffer or owner qualify, since inline data is freed as soon as the segment is consumed, while the kernel may still be reading it.
+			bool is_zero_copy_candidate(const Segment & segment) const;
+			
+			// Write the front segment by itself using MSG_ZEROCOPY.
+			IOResult try_write_zero_copy(FileDescriptor file_descriptor);
+			
+			// Write the front segment, which is a file range.
+			IOResult try_write_file(FileDescriptor file_descriptor);
+			
+			struct PendingSegment
+			{
+				std::uint32_t sequence;
+				Segment segment;
+			};
+			
+			std::size_t _zero_copy_threshold = 0;
+			
+			// The kernel numbers each successful zero-copy send sequentially, starting from zero.
+			std::uint32_t _zero_copy_sequence = 0;
+			std::deque<PendingSegment> _zero_copy_pending;
 			
+			std::size_t _zero_copy_count = 0, _zero_copy_copied_count = 0;
 		};
 	}
 }
@@ -0,0 +1,97 @@
+//
+//  PrefixTable.cpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include "PrefixTable.hpp"
+
+#include <cstdlib>
+
+#include <string.h>
+#include <arpa/inet.h>
+
+namespace Dream
+{
+	namespace Network
+	{
+		bool PrefixKey::from_address (const sockaddr * address_data, std::size_t size, PrefixKey & key)
+		{
+			if (size == 0)
+				return false;
+			
+			if (address_data->sa_family == AF_INET) {
+				const sockaddr_in * address = (const sockaddr_in *)address_data;
+				
+				key.family = AF_INET;
+				key.length = 32;
+				memcpy(key.bytes, &address->sin_addr, 4);
+				
+				return true;
+			} else if (address_data->sa_family == AF_INET6) {
+				const sockaddr_in6 * address = (const sockaddr_in6 *)address_data;
+				
+				// Connections accepted on a dual-stack socket arrive as IPv4-mapped addresses:
+				if (IN6_IS_ADDR_V4MAPPED(&address->sin6_addr)) {
+					key.family = AF_INET;
+					key.length = 32;
+					memcpy(key.bytes, address->sin6_addr.s6_addr + 12, 4);
+				} else {
+					key.family = AF_INET6;
+					key.length = 128;
+					memcpy(key.bytes, &address->sin6_addr, 16);
+				}
+				
+				return true;
+			}
+			
+			return false;
+		}
+		
+		bool PrefixKey::parse (const std::string & cidr, PrefixKey & key, std::size_t & prefix_length)
+		{
+			std::string host = cidr;
+			std::size_t slash = cidr.find('/');
+			
+			if (slash != std::string::npos)
+				host = cidr.substr(0, slash);
+			
+			if (inet_pton(AF_INET, host.c_str(), key.bytes) == 1) {
+				key.family = AF_INET;
+				key.length = 32;
+			} else if (inet_pton(AF_INET6, host.c_str(), key.bytes) == 1) {
+				key.family = AF_INET6;
+				key.length = 128;
+			} else {
+				return false;
+			}
+			
+			if (slash == std::string::npos) {
+				prefix_length = key.length;
+			} else {
+				const char * begin = cidr.c_str() + slash + 1;
+				char * end = nullptr;
+				
+				unsigned long length = strtoul(begin, &end, 10);
+				
+				if (end == begin || *end != '\0' || length > key.length)
+					return false;
+				
+				prefix_length = length;
+			}
+			
+			// Store IPv4-mapped prefixes with the IPv4 addresses they match:
+			if (key.family == AF_INET6 && prefix_length >= 96 && IN6_IS_ADDR_V4MAPPED((const in6_addr *)key.bytes)) {
+				memmove(key.bytes, key.bytes + 12, 4);
+				
+				key.family = AF_INET;
+				key.length = 32;
+				prefix_length -= 96;
+			}
+			
+			return true;
+		}
+	}
+}
@@ -0,0 +1,161 @@
+//
+//  PrefixTable.hpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#pragma once
+
+#include "Address.hpp"
+
+#include <memory>
+
+namespace Dream
+{
+	namespace Network
+	{
+		/// The host part of an IPv4 or IPv6 address, as a sequence of bits in network order. IPv4-mapped IPv6 addresses (::ffff:a.b.c.d) are treated as IPv4.
+		struct PrefixKey
+		{
+			AddressFamily family = AF_UNSPEC;
+			unsigned char bytes[16];
+			/// The total number of bits in the address, 32 or 128.
+			std::size_t length = 0;
+			
+			bool bit (std::size_t index) const { return (bytes[index / 8] >> (7 - (index % 8))) & 1; }
+			
+			/// Extract the key from the given address data. Returns false if the address isn't IPv4 or IPv6.
+			static bool from_address (const sockaddr * address_data, std::size_t size, PrefixKey & key);
+			
+			/// Parse a prefix in CIDR notation, e.g. "10.0.0.0/8" or "2001:db8::/32". A plain address is a prefix of its full length. Returns false if the prefix is malformed.
+			static bool parse (const std::string & cidr, PrefixKey & key, std::size_t & prefix_length);
+		};
+		
+		/** Maps IPv4 and IPv6 prefixes to values using the longest matching prefix.
+		
+		 A binary trie per address family, so lookup() visits at most 32 (IPv4) or 128 (IPv6) nodes regardless of how many prefixes are stored. This is suitable for allow/deny lists and per-subnet limits which are consulted on every accepted connection.
+		 */
+		template <typename ValueT>
+		class PrefixTable
+		{
+		public:
+			/// Associate the value with all addresses matching the prefix, replacing any existing value for exactly the same prefix.
+			void insert (const PrefixKey & prefix, std::size_t prefix_length, const ValueT & value)
+			{
+				DREAM_ASSERT(prefix_length <= prefix.length);
+				
+				std::unique_ptr<Node> * node = &root_for(prefix.family);
+				
+				if (!*node) node->reset(new Node);
+				
+				for (std::size_t i = 0; i < prefix_length; i += 1) {
+					node = &(*node)->children[prefix.bit(i)];
+					
+					if (!*node) node->reset(new Node);
+				}
+				
+				if (!(*node)->has_value) {
+					(*node)->has_value = true;
+					_size += 1;
+				}
+				
+				(*node)->value = value;
+			}
+			
+			/// Associate the value with the prefix of the given length of the address.
+			bool insert (const Address & address, std::size_t prefix_length, const ValueT & value)
+			{
+				PrefixKey key;
+				
+				if (!PrefixKey::from_address(address.address_data(), address.address_data_size(), key) || prefix_length > key.length)
+					return false;
+				
+				insert(key, prefix_length, value);
+				
+				return true;
+			}
+			
+			/// Associate the value with a prefix in CIDR notation. Returns false if the prefix is malformed.
+			bool insert (const std::string & cidr, const ValueT & value)
+			{
+				PrefixKey key;
+				std::size_t prefix_length;
+				
+				if (!PrefixKey::parse(cidr, key, prefix_length))
+					return false;
+				
+				insert(key, prefix_length, value);
+				
+				return true;
+			}
+			
+			/// Find the value for the longest prefix matching the key, or nullptr if no prefix matches.
+			const ValueT * lookup (const PrefixKey & key) const
+			{
+				const Node * node = root_for(key.family).get();
+				const ValueT * match = nullptr;
+				
+				for (std::size_t i = 0; node; i += 1) {
+					if (node->has_value)
+						match = &node->value;
+					
+					if (i == key.length)
+						break;
+					
+					node = node->children[key.bit(i)].get();
+				}
+				
+				return match;
+			}
+			
+			const ValueT * lookup (const sockaddr * address_data, std::size_t size) const
+			{
+				PrefixKey key;
+				
+				if (!PrefixKey::from_address(address_data, size, key))
+					return nullptr;
+				
+				return lookup(key);
+			}
+			
+			const ValueT * lookup (const Address & address) const
+			{
+				return lookup(address.address_data(), address.address_data_size());
+			}
+			
+			/// The number of prefixes in the table.
+			std::size_t size () const { return _size; }
+			bool empty () const { return _size == 0; }
+			
+			void clear ()
+			{
+				_ipv4_root.reset();
+				_ipv6_root.reset();
+				_size = 0;
+			}
+			
+		private:
+			struct Node
+			{
+				std::unique_ptr<Node> children[2];
+				bool has_value = false;
+				ValueT value = ValueT();
+			};
+			
+			std::unique_ptr<Node> & root_for (AddressFamily family)
+			{
+				return family == AF_INET ? _ipv4_root : _ipv6_root;
+			}
+			
+			const std::unique_ptr<Node> & root_for (AddressFamily family) const
+			{
+				return family == AF_INET ? _ipv4_root : _ipv6_root;
+			}
+			
+			std::unique_ptr<Node> _ipv4_root, _ipv6_root;
+			std::size_t _size = 0;
+		};
+	}
+}
@@ -0,0 +1,229 @@
+//
+//  Resolver.cpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include "Resolver.hpp"
+
+#include <Dream/Events/Source.hpp>
+
+namespace Dream
+{
+	namespace Network
+	{
+		Resolver::Resolver(std::size_t thread_count, TimeT positive_ttl, TimeT negative_ttl, std::size_t maximum_cache_size) : _positive_ttl(positive_ttl), _negative_ttl(negative_ttl), _maximum_cache_size(maximum_cache_size)
+		{
+			for (std::size_t i = 0; i < thread_count; i += 1) {
+				_threads.push_back(std::thread(&Resolver::run, this));
+			}
+		}
+		
+		Resolver::~Resolver()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				_stopping = true;
+			}
+			
+			_condition.notify_all();
+			
+			for (auto & thread : _threads) {
+				thread.join();
+			}
+		}
+		
+		std::string Resolver::key_for(const std::string & host, const std::string & service, SocketType socket_type)
+		{
+			std::string key = host;
+			
+			key += '\0';
+			key += service;
+			key += '\0';
+			key += std::to_string(socket_type);
+			
+			return key;
+		}
+		
+		void Resolver::deliver(const Waiter & waiter, const AddressesT & addresses, int error)
+		{
+			CallbackT callback = waiter.callback;
+			
+			waiter.event_loop->post_notification(new Events::NotificationSource([callback, addresses, error](Events::Loop * event_loop, Events::NotificationSource *, Events::Event) {
+				callback(event_loop, addresses, error);
+			}));
+		}
+		
+		void Resolver::resolve(Events::Loop * event_loop, const std::string & host, const Service & service, SocketType socket_type, CallbackT callback)
+		{
+			std::string key = key_for(host, service.name(), socket_type);
+			Waiter waiter{event_loop, callback};
+			
+			AddressesT addresses;
+			int error = 0;
+			
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				
+				if (lookup(key, addresses, error)) {
+					_cache_hit_count += 1;
+				} else {
+					_cache_miss_count += 1;
+					
+					auto & waiters = _pending[key];
+					waiters.push_back(waiter);
+					
+					// Only the first request for a given key needs to be resolved.
+					if (waiters.size() == 1) {
+						_requests.push_back({key, host, service.name(), socket_type});
+						_condition.notify_one();
+					}
+					
+					return;
+				}
+			}
+			
+			deliver(waiter, addresses, error);
+		}
+		
+		void Resolver::resolve(Events::Loop * event_loop, const URI & uri, SocketType socket_type, CallbackT callback)
+		{
+			resolve(event_loop, uri.hostname(), uri.service(), socket_type, callback);
+		}
+		
+		bool Resolver::lookup(const std::string & key, AddressesT & addresses, int & error)
+		{
+			auto entry = _cache.find(key);
+			
+			if (entry == _cache.end())
+				return false;
+			
+			if (entry->second.expires < ClockT::now()) {
+				_cache.erase(entry);
+				
+				return false;
+			}
+			
+			addresses = entry->second.addresses;
+			error = entry->second.error;
+			
+			return true;
+		}
+		
+		void Resolver::store(const std::string & key, const Entry & entry)
+		{
+			auto existing = _cache.find(key);
+			
+			if (existing != _cache.end()) {
+				existing->second = entry;
+				
+				return;
+			}
+			
+			if (_maximum_cache_size && _cache.size() >= _maximum_cache_size) {
+				auto now = ClockT::now();
+				auto soonest = _cache.end();
+				
+				// Expired entries are otherwise only discarded when the same key is looked up again, so sweep them all while we are here:
+				for (auto iterator = _cache.begin(); iterator != _cache.end();) {
+					if (iterator->second.expires < now) {
+						iterator = _cache.erase(iterator);
+					} else {
+						if (soonest == _cache.end() || iterator->second.expires < soonest->second.expires)
+							soonest = iterator;
+						
+						iterator++;
+					}
+				}
+				
+				if (_cache.size() >= _maximum_cache_size)
+					_cache.erase(soonest);
+			}
+			
+			_cache.insert({key, entry});
+		}
+		
+		bool Resolver::lookup(const std::string & host, const Service & service, SocketType socket_type, AddressesT & addresses, int & error)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			return lookup(key_for(host, service.name(), socket_type), addresses, error);
+		}
+		
+		void Resolver::clear_cache()
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			_cache.clear();
+		}
+		
+		std::size_t Resolver::cache_size() const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			return _cache.size();
+		}
+		
+		std::size_t Resolver::cache_hit_count() const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			return _cache_hit_count;
+		}
+		
+		std::size_t Resolver::cache_miss_count() const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			return _cache_miss_count;
+		}
+		
+		void Resolver::run()
+		{
+			while (true) {
+				Request request;
+				
+				{
+					std::unique_lock<std::mutex> lock(_lock);
+					
+					_condition.wait(lock, [this]{return _stopping || !_requests.empty();});
+					
+					if (_stopping)
+						return;
+					
+					request = _requests.front();
+					_requests.pop_front();
+				}
+				
+				AddressesT addresses;
+				int error = 0;
+				
+				try {
+					addresses = Address::addresses_for_name(request.host.empty() ? nullptr : request.host.c_str(), request.service, request.socket_type);
+				} catch (AddressResolutionError & resolution_error) {
+					error = resolution_error.error_code();
+				}
+				
+				std::vector<Waiter> waiters;
+				
+				{
+					std::lock_guard<std::mutex> lock(_lock);
+					
+					TimeT ttl = error ? _negative_ttl : _positive_ttl;
+					auto expires = ClockT::now() + std::chrono::duration_cast<ClockT::duration>(std::chrono::duration<TimeT>(ttl));
+					
+					store(request.key, {addresses, error, expires});
+					
+					waiters.swap(_pending[request.key]);
+					_pending.erase(request.key);
+				}
+				
+				for (auto & waiter : waiters) {
+					deliver(waiter, addresses, error);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,121 @@
+//
+//  Resolver.hpp
+//  File file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#pragma once
+
+#include "Address.hpp"
+
+#include <Dream/Events/Loop.hpp>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <map>
+
+namespace Dream
+{
+	namespace Network
+	{
+		/** Resolves names to addresses without blocking the event loop.
+
+		 Address::addresses_for_name uses getaddrinfo, which blocks the calling thread for as long as resolution takes. A resolver runs these lookups on
+		 a small pool of threads, and delivers the results back to the requesting event loop. Results are cached, so repeated requests for the same name
+		 skip resolution entirely until the entry expires. Failures are cached for a shorter time, so that a missing name doesn't cause a lookup on every
+		 connection attempt. Concurrent requests for the same name share a single lookup.
+
+		 getaddrinfo doesn't expose record TTLs, so the cache lifetimes are fixed. The cache holds a bounded number of entries: when it is full, expired entries
+ are discarded, and failing that, the entry closest to expiry.
+
+		 */
+		class Resolver : public Object
+		{
+		public:
+			/// Invoked on the requesting event loop. The error is zero on success, otherwise the getaddrinfo error code.
+			typedef std::function<void (Events::Loop *, const AddressesT & addresses, int error)> CallbackT;
+			
+			/// @param thread_count the number of threads used to perform lookups.
+			/// @param positive_ttl the number of seconds successful lookups are cached.
+			/// @param negative_ttl the number of seconds failed lookups are cached.
+			/// @param maximum_cache_size the maximum number of cached results.
+			Resolver(std::size_t thread_count = 2, TimeT positive_ttl = 60, TimeT negative_ttl = 5, std::size_t maximum_cache_size = 1024);
+			virtual ~Resolver();
+			
+			/// Resolve a host and service, and invoke the callback on the given event loop with the results.
+			void resolve(Events::Loop * event_loop, const std::string & host, const Service & service, SocketType socket_type, CallbackT callback);
+			
+			/// Resolve a URI of the form service://hostname/, and invoke the callback on the given event loop with the results.
+			void resolve(Events::Loop * event_loop, const URI & uri, SocketType socket_type, CallbackT callback);
+			
+			/// Look up a cached result without resolving.
+			/// @returns true if a result was cached.
+			bool lookup(const std::string & host, const Service & service, SocketType socket_type, AddressesT & addresses, int & error);
+			
+			/// Discard all cached results.
+			void clear_cache();
+			
+			/// The number of results currently cached, including any which have expired but not yet been discarded.
+			std::size_t cache_size() const;
+			
+			/// The number of requests answered from the cache.
+			std::size_t cache_hit_count() const;
+			/// The number of requests which required resolution.
+			std::size_t cache_miss_count() const;
+			
+		private:
+			typedef std::chrono::steady_clock ClockT;
+			
+			struct Waiter
+			{
+				Ref<Events::Loop> event_loop;
+				CallbackT callback;
+			};
+			
+			struct Request
+			{
+				std::string key;
+				std::string host;
+				std::string service;
+				SocketType socket_type;
+			};
+			
+			struct Entry
+			{
+				AddressesT addresses;
+				int error;
+				ClockT::time_point expires;
+			};
+			
+			static std::string key_for(const std::string & host, const std::string & service, SocketType socket_type);
+			static void deliver(const Waiter & waiter, const AddressesT & addresses, int error);
+			
+			bool lookup(const std::string & key, AddressesT & addresses, int & error);
+			
+			/// Insert an entry into the cache, making room for it if the cache is full.
+			void store(const std::string & key, const Entry & entry);
+			
+			void run();
+			
+			TimeT _positive_ttl, _negative_ttl;
+			std::size_t _maximum_cache_size;
+			
+			mutable std::mutex _lock;
+			std::condition_variable _condition;
+			bool _stopping = false;
+			
+			std::deque<Request> _requests;
+			std::map<std::string, std::vector<Waiter>> _pending;
+			std::map<std::string, Entry> _cache;
+			
+			std::size_t _cache_hit_count = 0, _cache_miss_count = 0;
+			
+			std::vector<std::thread> _threads;
+		};
+	}
+}
@@ -12,16 +12,34 @@
 #include <Dream/Core/Timer.hpp>
 #include <Dream/Core/System.hpp>
 #include <Dream/Events/Loop.hpp>
+#include <Dream/Events/Source.hpp>
 #include <Dream/Core/Logger.hpp>
 
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+
+#include <sstream>
+
 namespace Dream {
 	namespace Network {
 		using namespace Events;
 		using namespace Dream::Core::Logging;
+		using Core::SystemError;
 
-		ServerContainer::ServerContainer () : _run(false)
+		ServerContainer::ServerContainer (std::size_t worker_count) : _run(false)
 		{
 			_event_loop = new Loop;
+
+			for (std::size_t i = 0; i < worker_count; i += 1) {
+				Ref<Loop> worker_loop = new Loop;
+
+				// Worker loops have nothing to monitor until connections are handed to them.
+				worker_loop->set_stop_when_idle(false);
+
+				_worker_loops.push_back(worker_loop);
+			}
 		}
 
 		ServerContainer::~ServerContainer ()
@@ -29,16 +47,33 @@ namespace Dream {
 			stop();
 		}
 
+		std::size_t ServerContainer::hardware_concurrency ()
+		{
+			std::size_t count = std::thread::hardware_concurrency();
+
+			return count ? count : 1;
+		}
+
 		void ServerContainer::run ()
 		{
 			_event_loop->run_forever();
 		}
 
+		void ServerContainer::run_worker (Ref<Loop> worker_loop)
+		{
+			worker_loop->run_forever();
+		}
+
 		Ref<Loop> ServerContainer::event_loop ()
 		{
 			return _event_loop;
 		}
 
+		const std::vector<Ref<Loop>> & ServerContainer::worker_loops () const
+		{
+			return _worker_loops;
+		}
+
 		void ServerContainer::start (Ref<Server> server) {
 			if (!_run) {
 				_server = server;
@@ -49,6 +84,12 @@ namespace Dream {
 
 				DREAM_ASSERT(!_thread);
 
+				if (!_worker_loops.empty())
+					_server->set_worker_loops(_worker_loops);
+
+				for (auto worker_loop : _worker_loops)
+					_worker_threads.push_back(Shared<std::thread>(new std::thread(std::bind(&ServerContainer::run_worker, this, worker_loop))));
+
 				_thread = new std::thread(std::bind(&ServerContainer::run, this));
 			}
 		}
@@ -63,6 +104,19 @@ namespace Dream {
 				_thread->join();
 				_thread = NULL;
 
+				// Stop the workers once no more connections can be handed to them.
+				for (auto worker_loop : _worker_loops)
+					worker_loop->stop();
+
+				for (auto worker_thread : _worker_threads)
+					worker_thread->join();
+
+				_worker_threads.clear();
+
+				// Release any shards, which would otherwise be left listening on runloops that no longer run. They are bound again by start().
+				if (!_worker_loops.empty())
+					_server->set_worker_loops(std::vector<Ref<Loop>>());
+
 				_run = false;
 			}
 		}
@@ -71,6 +125,12 @@ namespace Dream {
 		{
 		}
 
+		Server::Server (Ref<Loop> event_loop, const std::vector<SocketHandleT> & listening_handles) : _event_loop(event_loop)
+		{
+			for (auto h : listening_handles)
+				adopt_server_socket(h);
+		}
+
 		Server::~Server ()
 		{
 			if (_event_loop) {
@@ -79,6 +139,11 @@ namespace Dream {
 					_event_loop->stop_monitoring_file_descriptor(server_socket);
 				}
 			}
+
+			release_shards();
+
+			for (auto server_socket : _spare_server_sockets)
+				_event_loop->stop_monitoring_file_descriptor(server_socket);
 		}
 
 		void Server::bind_to_service (const Service & service, SocketType sock_type)
@@ -101,15 +166,267 @@ namespace Dream {
 		
 		Ref<ServerSocket> Server::bind_to_address (const Address & address)
 		{
+			// An adopted socket is already listening on the address, and binding another would split its connections.
+			for (auto server_socket : _server_sockets) {
+				if (server_socket->bound_address() == address)
+					return server_socket;
+			}
+
 			Ref<ServerSocket> server_socket = new ServerSocket(address);
 			
-			server_socket->connection_callback = std::bind(&Server::connection_callback, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4);
+			server_socket->connection_callback = std::bind(&Server::dispatch_connection, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4);
 
 			_server_sockets.push_back(server_socket);
 
 			_event_loop->monitor(server_socket);
+
+			if (_sharded) {
+				for (auto worker_loop : _worker_loops)
+					bind_shard(worker_loop, address);
+			}
 			
 			return server_socket;
 		}
+
+		Ref<ServerSocket> Server::adopt_server_socket (SocketHandleT h)
+		{
+			Ref<ServerSocket> server_socket = new ServerSocket(h);
+
+			server_socket->connection_callback = std::bind(&Server::dispatch_connection, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4);
+
+			_event_loop->monitor(server_socket);
+
+			for (auto existing : _server_sockets) {
+				if (existing->bound_address() == server_socket->bound_address()) {
+					_spare_server_sockets.push_back(server_socket);
+
+					return server_socket;
+				}
+			}
+
+			_server_sockets.push_back(server_socket);
+
+			if (_sharded) {
+				for (auto worker_loop : _worker_loops)
+					bind_shard(worker_loop, server_socket->bound_address());
+			}
+
+			return server_socket;
+		}
+
+		std::vector<SocketHandleT> Server::listening_handles () const
+		{
+			std::vector<SocketHandleT> handles;
+
+			for (auto server_socket : _server_sockets)
+				handles.push_back(server_socket->file_descriptor());
+
+			// Connections may be queued on any shard, so they must be handed over as well:
+			for (auto & shard : _shards)
+				handles.push_back(shard.server_socket->file_descriptor());
+
+			for (auto server_socket : _spare_server_sockets)
+				handles.push_back(server_socket->file_descriptor());
+
+			return handles;
+		}
+
+		IOResult Server::send_listeners (Socket * channel) const
+		{
+			std::vector<SocketHandleT> handles = listening_handles();
+
+			DREAM_ASSERT(handles.size() <= Socket::MAXIMUM_DESCRIPTORS);
+
+			// The count accompanies the handles, so that the receiver can tell if any were discarded.
+			uint32_t count = handles.size();
+
+			return channel->try_send_descriptors((const Byte *)&count, sizeof(count), handles.data(), handles.size());
+		}
+
+		IOResult Server::receive_listeners (Socket * channel, std::vector<SocketHandleT> & handles)
+		{
+			uint32_t expected = 0;
+			SocketHandleT received[Socket::MAXIMUM_DESCRIPTORS];
+			std::size_t count = Socket::MAXIMUM_DESCRIPTORS;
+
+			IOResult result = channel->try_receive_descriptors((Byte *)&expected, sizeof(expected), received, count);
+
+			if (!result.is_ok())
+				return result;
+
+			if (result.size != sizeof(expected) || count != expected) {
+				for (std::size_t i = 0; i < count; i += 1)
+					::close(received[i]);
+
+				return IOResult(IOStatus::FAILED, 0, EPROTO);
+			}
+
+			handles.insert(handles.end(), received, received + count);
+
+			return result;
+		}
+
+		void Server::export_listeners (const char * variable) const
+		{
+			std::stringstream buffer;
+
+			for (auto h : listening_handles()) {
+				// Listening sockets are inherited across exec only if they aren't close-on-exec:
+				int flags = fcntl(h, F_GETFD, 0);
+
+				if (flags == -1 || fcntl(h, F_SETFD, flags & ~FD_CLOEXEC) == -1)
+					SystemError::check(__func__);
+
+				if (buffer.tellp() > 0)
+					buffer << ',';
+
+				buffer << h;
+			}
+
+			if (::setenv(variable, buffer.str().c_str(), 1) == -1)
+				SystemError::check(__func__);
+		}
+
+		std::vector<SocketHandleT> Server::import_listeners (const char * variable)
+		{
+			std::vector<SocketHandleT> handles;
+			const char * value = ::getenv(variable);
+
+			if (value == nullptr)
+				return handles;
+
+			std::stringstream buffer(value);
+			SocketHandleT h;
+
+			while (buffer >> h) {
+				struct stat status;
+
+				if (::fstat(h, &status) == 0 && S_ISSOCK(status.st_mode)) {
+					// Don't leak the sockets into any further children:
+					fcntl(h, F_SETFD, FD_CLOEXEC);
+
+					handles.push_back(h);
+				}
+
+				// Skip the separator:
+				buffer.ignore(1, ',');
+			}
+
+			::unsetenv(variable);
+
+			return handles;
+		}
+
+		void Server::stop_accepting ()
+		{
+			for (auto server_socket : _server_sockets)
+				_event_loop->stop_monitoring_file_descriptor(server_socket);
+
+			for (auto server_socket : _spare_server_sockets)
+				_event_loop->stop_monitoring_file_descriptor(server_socket);
+
+			_server_sockets.clear();
+			_spare_server_sockets.clear();
+
+			release_shards();
+		}
+
+		void Server::bind_shard (Ref<Loop> worker_loop, const Address & address)
+		{
+			Ref<ServerSocket> server_socket;
+
+			// A spare socket adopted from another server's shards is already listening, and may have connections queued on it:
+			for (auto spare = _spare_server_sockets.begin(); spare != _spare_server_sockets.end(); ++spare) {
+				if ((*spare)->bound_address() == address) {
+					server_socket = *spare;
+
+					_event_loop->stop_monitoring_file_descriptor(server_socket);
+					_spare_server_sockets.erase(spare);
+
+					break;
+				}
+			}
+
+			if (!server_socket)
+				server_socket = new ServerSocket(address);
+
+			// Connections accepted by a shard are already on the right runloop, which dispatch_connection takes into account.
+			server_socket->connection_callback = std::bind(&Server::dispatch_connection, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4);
+
+			_shards.push_back({worker_loop, server_socket});
+
+			worker_loop->monitor(server_socket);
+		}
+
+		void Server::release_shards ()
+		{
+			for (auto & shard : _shards)
+				shard.event_loop->stop_monitoring_file_descriptor(shard.server_socket);
+
+			_shards.clear();
+		}
+
+		void Server::set_worker_loops (const std::vector<Ref<Loop>> & worker_loops)
+		{
+			_worker_loops = worker_loops;
+			_next_worker_loop = 0;
+
+			if (_sharded) {
+				// The shards belong to the previous runloops, e.g. when a container is stopped and started again:
+				release_shards();
+
+				for (auto server_socket : _server_sockets) {
+					for (auto worker_loop : _worker_loops)
+						bind_shard(worker_loop, server_socket->bound_address());
+				}
+			}
+		}
+
+		void Server::set_sharded (bool sharded)
+		{
+			DREAM_ASSERT(_worker_loops.empty());
+
+			_sharded = sharded;
+		}
+
+		Ref<Loop> Server::next_worker_loop ()
+		{
+			if (_worker_loops.empty())
+				return _event_loop;
+
+			Ref<Loop> worker_loop = _worker_loops[_next_worker_loop];
+
+			_next_worker_loop = (_next_worker_loop + 1) % _worker_loops.size();
+
+			return worker_loop;
+		}
+
+		void Server::dispatch_connection (Loop * event_loop, ServerSocket * server_socket, const SocketHandleT & h, const Address & address)
+		{
+			// Reject as early as possible, before anything is allocated for the connection:
+			if (!_admission_control.admit(address)) {
+				::close(h);
+
+				return;
+			}
+
+			// When sharded, the server runloop is simply one more shard.
+			if (_worker_loops.empty() || _sharded) {
+				connection_callback(event_loop, server_socket, h, address);
+
+				return;
+			}
+
+			Ref<Loop> worker_loop = next_worker_loop();
+
+			// The socket handle and address are captured by value, as the notification is processed on the worker thread.
+			// The server socket is retained too, since stop_accepting() may release it before the notification is processed.
+			SocketHandleT socket_handle = h;
+			Ref<ServerSocket> accepting_socket(server_socket);
+
+			worker_loop->post_notification(new NotificationSource([this, accepting_socket, socket_handle, address](Loop * loop, NotificationSource *, Event) {
+				connection_callback(loop, accepting_socket.get(), socket_handle, address);
+			}));
+		}
 	}
 }
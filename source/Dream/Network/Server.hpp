@@ -10,6 +10,7 @@
 #pragma once
 
 #include "Socket.hpp"
+#include "Admission.hpp"
 
 #include <Dream/Events/Loop.hpp>
 
@@ -29,7 +30,13 @@ namespace Dream {
 		 begin communcation. You also need to override the constructor to call bind_to_service() with appropriate parameters.
 
 		 This class, when overriddden correctly, can act as a gatekeeper, checking the remote address or resource limits, and closing connections depending on
-		 circumstances.
+		 circumstances. Rate limits per address, per prefix and overall can be configured using admission_control(), in which case connections which exceed
+		 them are closed immediately after being accepted, without invoking connection_callback.
+
+		 To restart without refusing connections, a running server can hand its listening sockets to a new process, either over a unix-domain socket
+		 with send_listeners(), or across exec with export_listeners(). The new process adopts them with the Server constructor, after which the old
+		 server calls stop_accepting() and finishes its established connections. When sharded, the shards are handed over too, since connections
+		 may already be queued on them, and the new server uses them for its own shards.
 
 		 */
 		class Server : public Object {
@@ -40,12 +47,46 @@ namespace Dream {
 			/// The server runloop.
 			Ref<Events::Loop> _event_loop;
 
+			/// Worker runloops which accepted connections are distributed across. If empty, connections are handled on the server runloop.
+			std::vector<Ref<Events::Loop>> _worker_loops;
+			std::size_t _next_worker_loop = 0;
+
+			/// A listening socket bound to the same address as one of the _server_sockets, monitored by a worker runloop.
+			struct Shard {
+				Ref<Events::Loop> event_loop;
+				Ref<ServerSocket> server_socket;
+			};
+
+			/// Whether each worker runloop has its own listening socket.
+			bool _sharded = false;
+			std::vector<Shard> _shards;
+
+			/// Adopted listening sockets bound to the same address as one of the _server_sockets, i.e. another server's shards. Each is monitored
+			/// by the server runloop until bind_shard takes it over, so that connections already queued on it are still accepted.
+			std::vector<Ref<ServerSocket>> _spare_server_sockets;
+
+			/// Create an additional listening socket for the given address, or reuse a spare one, and monitor it on the given worker runloop.
+			void bind_shard (Ref<Events::Loop> worker_loop, const Address & address);
+
+			/// Stop monitoring and close all shards.
+			void release_shards ();
+
+			/// Connections are checked against these limits before connection_callback is invoked.
+			AdmissionControl _admission_control;
+
 			/// Override this function to handle incoming connection requests.
 			virtual void connection_callback (Events::Loop *, ServerSocket *, const SocketHandleT & h, const Address &) = 0;
+
+			/// Called by the ServerSocket when a connection has been accepted. Closes the connection if it isn't admitted, otherwise hands it to the next worker runloop, if any.
+			void dispatch_connection (Events::Loop *, ServerSocket *, const SocketHandleT & h, const Address &);
 			
 		public:
 			/// A server attaches to a runloop. It then should schedule incoming connections on the runloop.
 			Server (Ref<Events::Loop> event_loop);
+
+			/// Attach to a runloop, adopting listening sockets handed over by another process, e.g. from import_listeners() or receive_listeners().
+			/// Subsequent binds to the same addresses reuse the adopted sockets, so a subclass can bind as usual.
+			Server (Ref<Events::Loop> event_loop, const std::vector<SocketHandleT> & listening_handles);
 			
 			/// Creates a set of sockets bound to the appropriate service.
 			/// You need to call this in your subclass to bind to the appropriate ports/services.
@@ -53,8 +94,53 @@ namespace Dream {
 			void bind_to_service (const Service & service, SocketType sock_type);
 			void bind_to_service (PortNumber port_number, SocketType sock_type);
 			
-			// Bind to the given address. Returns the bound ServerSocket.
+			// Bind to the given address. Returns the bound ServerSocket. If a listening socket is already bound to the address, e.g. because it was
+			// adopted, that socket is returned instead.
 			Ref<ServerSocket> bind_to_address (const Address & address);
+
+			/// Accept connections on an existing listening socket, which the server takes ownership of. If another adopted socket is already bound
+			/// to the same address, this one is kept as a spare for bind_shard.
+			Ref<ServerSocket> adopt_server_socket (SocketHandleT h);
+
+			/// The handles of the listening sockets, including any shards, which another process can adopt to take over accepting connections
+			/// without refusing any.
+			std::vector<SocketHandleT> listening_handles () const;
+
+			/// Send the listening sockets to another process over a connected unix-domain socket. This server keeps accepting until stop_accepting()
+			/// is called, so that connections are never refused during the handoff.
+			IOResult send_listeners (Socket * channel) const;
+
+			/// Receive listening sockets sent by send_listeners(). The handles are owned by the caller, typically passed to the Server constructor.
+			static IOResult receive_listeners (Socket * channel, std::vector<SocketHandleT> & handles);
+
+			/// Make the listening sockets inheritable, and record their handles in the given environment variable, so that a process started with
+			/// exec can adopt them using import_listeners().
+			void export_listeners (const char * variable = "DREAM_LISTEN_FDS") const;
+
+			/// Take the listening sockets recorded in the given environment variable by export_listeners() in a parent process, and remove the
+			/// variable. Handles which aren't sockets are ignored.
+			static std::vector<SocketHandleT> import_listeners (const char * variable = "DREAM_LISTEN_FDS");
+
+			/// Stop monitoring and release the listening sockets, e.g. once another process has adopted them. Connections waiting to be accepted
+			/// stay queued for the other process, as the listening sockets remain open there.
+			void stop_accepting ();
+
+			/// Distribute accepted connections round-robin across the given runloops. connection_callback will be invoked on the worker runloop's thread.
+			/// This should be set before the runloops are started, typically by ServerContainer::start. Setting it again rebinds any shards to the new runloops.
+			void set_worker_loops (const std::vector<Ref<Events::Loop>> & worker_loops);
+
+			/// Rather than handing accepted connections to worker runloops, bind one listening socket per worker runloop to each address, and let the
+			/// kernel distribute incoming connections between them using SO_REUSEPORT. Connections are then handled on the runloop which accepted them.
+			/// This must be enabled before set_worker_loops is called. Addresses with an ephemeral port (0) can't be sharded.
+			void set_sharded (bool sharded = true);
+			bool is_sharded () const { return _sharded; }
+
+			/// Rate limits for incoming connections. By default, all connections are admitted.
+			AdmissionControl & admission_control () { return _admission_control; }
+			const AdmissionControl & admission_control () const { return _admission_control; }
+
+			/// The runloop which will receive the next accepted connection.
+			Ref<Events::Loop> next_worker_loop ();
 			
 			virtual ~Server ();
 		};
@@ -69,25 +155,37 @@ namespace Dream {
 
 		 A server container provides all the needed infrastructure (such as runloop) to run the server correctly, and is designed to provide a very simple
 		 interface to starting and stopping a server thread.
+
+		 A container may also be constructed with a number of worker runloops, each running on its own thread. The server runloop accepts incoming
+		 connections and hands them to the worker runloops in turn, so that established connections are serviced by multiple cores.
 		 */
 		class ServerContainer : public Object {
 		protected:
 			bool _run;
 			Ref<Events::Loop> _event_loop;
+			std::vector<Ref<Events::Loop>> _worker_loops;
 
 			Ref<Server> _server;
 			Shared<std::thread> _thread;
+			std::vector<Shared<std::thread>> _worker_threads;
 
 			void run ();
+			void run_worker (Ref<Events::Loop> worker_loop);
 
 		public:
-			/// Construct a server container. This initializes a runloop.
-			ServerContainer ();
+			/// Construct a server container. This initializes a runloop, and the given number of worker runloops. With no workers, connections are handled on the server runloop.
+			ServerContainer (std::size_t worker_count = 0);
 			virtual ~ServerContainer ();
 
+			/// The number of hardware threads available, suitable for use as a worker count.
+			static std::size_t hardware_concurrency ();
+
 			/// The runloop for the container. Be careful about accessing this from a different thread.
 			Ref<Events::Loop> event_loop ();
 
+			/// The worker runloops for the container. Be careful about accessing these from a different thread.
+			const std::vector<Ref<Events::Loop>> & worker_loops () const;
+
 			/// Start the container with a given server.
 			void start (Ref<Server> server);
 
@@ -18,13 +18,18 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <netinet/tcp.h>
 #include <errno.h>
+#include <string.h>
 
 //#include <execinfo.h>
 #include <stdio.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 namespace Dream {
 	namespace Network {
 		using namespace Core::Logging;
@@ -95,6 +100,24 @@ namespace Dream {
 			}
 		}
 		
+		bool Socket::set_zero_copy (bool enabled) {
+#ifdef SO_ZEROCOPY
+			int value = enabled ? 1 : 0;
+
+			if (setsockopt(_socket, SOL_SOCKET, SO_ZEROCOPY, &value, sizeof(int)) == -1) {
+				// Older kernels, and sockets other than TCP/UDP, don't support it.
+				if (errno == ENOPROTOOPT || errno == EOPNOTSUPP || errno == EINVAL)
+					return false;
+
+				SystemError::check(__func__);
+			}
+
+			return true;
+#else
+			return false;
+#endif
+		}
+
 		void Socket::set_non_blocking(bool value) {
 			int flags = fcntl(_socket, F_GETFL, 0);
 			
@@ -155,28 +178,28 @@ namespace Dream {
 
 			//std::cout << "Sending " << buf.size() << " bytes..." << std::endl;
 
-			ssize_t sz = buf.size() - offset;
-
-			const Byte * data = buf.begin() + offset;
-
-			sz = ::send(_socket, data, sz, flags);
+			return send(buf.begin() + offset, buf.size() - offset, flags);
+		}
 
-			if (sz == 0)
-				throw ConnectionShutdown("write shutdown");
+		std::size_t Socket::send (const Byte * data, std::size_t size, int flags) {
+			return try_send(data, size, flags).value("write");
+		}
 
-			if (sz == -1) {
-				if (errno == ECONNRESET)
-					throw ConnectionResetByPeer("write error");
+		IOResult Socket::try_send (const Byte * data, std::size_t size, int flags) {
+			DREAM_ASSERT(size > 0);
 
-				SystemError::check(__func__);
+			return IOResult::from_system_call(::send(_socket, data, size, flags));
+		}
 
-				sz = 0;
-			}
+		std::size_t Socket::recv (Core::ResizableBuffer & buf, int flags) {
+			return try_recv(buf, flags).value("read");
+		}
 
-			return sz;
+		std::size_t Socket::recv (Byte * data, std::size_t size, int flags) {
+			return try_recv(data, size, flags).value("read");
 		}
 
-		std::size_t Socket::recv (Core::ResizableBuffer & buf, int flags) {
+		IOResult Socket::try_recv (Core::ResizableBuffer & buf, int flags) {
 			DREAM_ASSERT(buf.size() < buf.capacity() && "Please make sure you have reserved space for incoming data");
 
 			//std::cout << "Receiving " << (buf.capacity() - buf.size()) << " bytes..." << std::endl;
@@ -188,24 +211,153 @@ namespace Dream {
 			buf.resize(buf.capacity());
 
 			// We read the size in the buffer
-			ssize_t sz = ::recv(_socket, (void*)&buf[offset], buf.size() - offset, flags);
+			IOResult result = try_recv(&buf[offset], buf.size() - offset, flags);
 
-			if (sz == 0)
-				throw ConnectionShutdown("read shutdown");
+			// We resize to
+			buf.resize(offset + (result.is_ok() ? result.size : 0));
 
-			if (sz == -1) {
-				if (errno == ECONNRESET)
-					throw ConnectionResetByPeer("read error");
+			return result;
+		}
 
-				SystemError::check(__func__);
+		IOResult Socket::try_recv (Byte * data, std::size_t size, int flags) {
+			DREAM_ASSERT(size > 0);
+
+			return IOResult::from_system_call(::recv(_socket, (void*)data, size, flags));
+		}
+
+		// Space for the largest SCM_RIGHTS control message, aligned as a cmsghdr.
+		union DescriptorControl {
+			char buffer[CMSG_SPACE(sizeof(int) * Socket::MAXIMUM_DESCRIPTORS)];
+			struct cmsghdr alignment;
+		};
+
+		IOResult Socket::try_send_descriptors (const Byte * data, std::size_t size, const FileDescriptor * descriptors, std::size_t count) {
+			DREAM_ASSERT(size > 0);
+			DREAM_ASSERT(count <= MAXIMUM_DESCRIPTORS);
+
+			struct iovec iov;
+			iov.iov_base = (void *)data;
+			iov.iov_len = size;
 
-				sz = 0;
+			struct msghdr message;
+			memset(&message, 0, sizeof(message));
+			message.msg_iov = &iov;
+			message.msg_iovlen = 1;
+
+			DescriptorControl control;
+
+			if (count > 0) {
+				message.msg_control = control.buffer;
+				message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+				struct cmsghdr * header = CMSG_FIRSTHDR(&message);
+				header->cmsg_level = SOL_SOCKET;
+				header->cmsg_type = SCM_RIGHTS;
+				header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+
+				memcpy(CMSG_DATA(header), descriptors, sizeof(int) * count);
 			}
 
-			// We resize to
-			buf.resize(offset + sz);
+			return IOResult::from_system_call(::sendmsg(_socket, &message, 0));
+		}
+
+		IOResult Socket::try_receive_descriptors (Byte * data, std::size_t size, FileDescriptor * descriptors, std::size_t & count) {
+			DREAM_ASSERT(size > 0);
+
+			std::size_t capacity = (count < MAXIMUM_DESCRIPTORS) ? count : MAXIMUM_DESCRIPTORS;
+			count = 0;
+
+			struct iovec iov;
+			iov.iov_base = data;
+			iov.iov_len = size;
+
+			struct msghdr message;
+			memset(&message, 0, sizeof(message));
+			message.msg_iov = &iov;
+			message.msg_iovlen = 1;
+
+			DescriptorControl control;
+
+			if (capacity > 0) {
+				message.msg_control = control.buffer;
+				message.msg_controllen = CMSG_SPACE(sizeof(int) * capacity);
+			}
+
+#ifdef MSG_CMSG_CLOEXEC
+			// Set close-on-exec in the same system call, so that the descriptors can't leak into a child process.
+			IOResult result = IOResult::from_system_call(::recvmsg(_socket, &message, MSG_CMSG_CLOEXEC));
+#else
+			IOResult result = IOResult::from_system_call(::recvmsg(_socket, &message, 0));
+#endif
+
+			if (!result.is_ok())
+				return result;
 
-			return sz;
+			for (struct cmsghdr * header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+				if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+					continue;
+
+				std::size_t received = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+				for (std::size_t i = 0; i < received; i += 1) {
+					int descriptor;
+					memcpy(&descriptor, CMSG_DATA(header) + sizeof(int) * i, sizeof(int));
+
+#ifndef MSG_CMSG_CLOEXEC
+					fcntl(descriptor, F_SETFD, FD_CLOEXEC);
+#endif
+
+					if (count < capacity)
+						descriptors[count++] = descriptor;
+					else
+						::close(descriptor);
+				}
+			}
+
+			return result;
+		}
+
+		// The address which accompanies a connection passed by try_send_connection().
+		struct ConnectionRecord {
+			int32_t socket_type;
+			int32_t socket_protocol;
+			uint32_t size;
+			sockaddr_storage address_data;
+		};
+
+		IOResult Socket::try_send_connection (SocketHandleT handle, const Address & address) {
+			ConnectionRecord record;
+			memset(&record, 0, sizeof(record));
+
+			record.socket_type = address.socket_type();
+			record.socket_protocol = address.socket_protocol();
+			record.size = address.address_data_size();
+			memcpy(&record.address_data, address.address_data(), address.address_data_size());
+
+			return try_send_descriptors((const Byte *)&record, sizeof(record), &handle, 1);
+		}
+
+		IOResult Socket::try_receive_connection (SocketHandleT & handle, Address & address) {
+			ConnectionRecord record;
+			std::size_t count = 1;
+
+			IOResult result = try_receive_descriptors((Byte *)&record, sizeof(record), &handle, count);
+
+			if (!result.is_ok())
+				return result;
+
+			if (count != 1 || result.size != sizeof(record) || record.size > sizeof(record.address_data)) {
+				if (count)
+					::close(handle);
+
+				handle = -1;
+
+				return IOResult(IOStatus::FAILED, 0, EPROTO);
+			}
+
+			address = Address((const sockaddr *)&record.address_data, record.size, record.socket_type, record.socket_protocol);
+
+			return result;
 		}
 
 // MARK: -
@@ -217,7 +369,43 @@ namespace Dream {
 
 			set_will_block(false);
 
-			log_debug("Server", this, "starting on address:", server_address.description(), "fd:", file_descriptor());
+			char address_buffer[Address::MAXIMUM_NUMERIC_LENGTH];
+			server_address.format_numeric(address_buffer, sizeof(address_buffer));
+
+			log_debug("Server", this, "starting on address:", address_buffer, "fd:", file_descriptor());
+		}
+
+		ServerSocket::ServerSocket (SocketHandleT h) : Socket(h) {
+			DREAM_ASSERT(is_valid());
+
+			sockaddr_storage storage;
+			socklen_t size = sizeof(storage);
+
+			if (::getsockname(_socket, (sockaddr *)&storage, &size) == -1)
+				SystemError::check(__func__);
+
+			int socket_type = 0, socket_protocol = 0;
+			socklen_t length = sizeof(int);
+
+			if (::getsockopt(_socket, SOL_SOCKET, SO_TYPE, &socket_type, &length) == -1)
+				SystemError::check(__func__);
+
+#ifdef SO_PROTOCOL
+			length = sizeof(int);
+
+			// This is informational only, so it isn't an error if it's unavailable:
+			if (::getsockopt(_socket, SOL_SOCKET, SO_PROTOCOL, &socket_protocol, &length) == -1)
+				socket_protocol = 0;
+#endif
+
+			_bound_address = Address((const sockaddr *)&storage, size, socket_type, socket_protocol);
+
+			set_will_block(false);
+
+			char address_buffer[Address::MAXIMUM_NUMERIC_LENGTH];
+			_bound_address.format_numeric(address_buffer, sizeof(address_buffer));
+
+			log_debug("Server", this, "adopted address:", address_buffer, "fd:", file_descriptor());
 		}
 
 		ServerSocket::~ServerSocket () {
@@ -231,17 +419,38 @@ namespace Dream {
 				SocketHandleT socket_handle;
 				Address address;
 
-				while (accept(socket_handle, address))
+				for (std::size_t count = 0; _accept_budget == 0 || count < _accept_budget; count += 1) {
+					if (!accept(socket_handle, address))
+						break;
+
 					connection_callback(event_loop, this, socket_handle, address);
+				}
 			}
 		}
 
+		// Remove the socket at the path of the address, if there is one. Abstract names have no path to remove.
+		static void unlink_unix_socket (const Address & address) {
+			std::string path = address.unix_path();
+
+			if (path.empty() || path[0] == '@')
+				return;
+
+			struct stat status;
+
+			if (::lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+				::unlink(path.c_str());
+		}
+
 		void ServerSocket::bind (const Address & address, bool reuse_address) {
 			open_socket(address);
 
 			DREAM_ASSERT(is_valid() && address.is_valid());
 
-			if (reuse_address) {
+			if (address.is_unix()) {
+				// Unix-domain sockets don't support SO_REUSEADDR, and instead fail to bind while the path exists:
+				if (reuse_address)
+					unlink_unix_socket(address);
+			} else if (reuse_address) {
 				set_reuse_address(true);
 			}
 
@@ -268,20 +477,39 @@ namespace Dream {
 		bool ServerSocket::accept (SocketHandleT & h, Address & na) {
 			DREAM_ASSERT(is_valid());
 
-			socklen_t len = sizeof(sockaddr_storage);
+			socklen_t len;
 			sockaddr_storage ss;
-			h = ::accept(_socket, (sockaddr*)&ss, &len);
+
+			// The connection may have been reset while waiting in the queue, which isn't an error for the listening socket, and other connections
+			// may still be queued behind it, so try again.
+			do {
+				len = sizeof(sockaddr_storage);
+
+#ifdef SOCK_NONBLOCK
+				// Set the flags on the new socket in the same system call.
+				h = ::accept4(_socket, (sockaddr*)&ss, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+				h = ::accept(_socket, (sockaddr*)&ss, &len);
+#endif
+			} while (h == -1 && (errno == ECONNABORTED || errno == EINTR));
 
 			if (h == -1) {
-				if (errno != EWOULDBLOCK) {
+				if (errno != EWOULDBLOCK && errno != EAGAIN) {
 					SystemError::check(__func__);
 				}
 
 				return false;
 			}
 
+#ifndef SOCK_NONBLOCK
+			if (fcntl(h, F_SETFL, fcntl(h, F_GETFL, 0) | O_NONBLOCK) == -1 || fcntl(h, F_SETFD, FD_CLOEXEC) == -1) {
+				::close(h);
+				SystemError::check(__func__);
+			}
+#endif
+
 			// Copy address
-			na = Address(_bound_address, (sockaddr*)&ss, len);
+			na.assign(_bound_address, (sockaddr*)&ss, len);
 
 			return true;
 		}
@@ -355,6 +583,207 @@ namespace Dream {
 			return false;
 		}
 
+		AddressesT ClientSocket::interleave_address_families (const AddressesT & addresses)
+		{
+			if (addresses.empty())
+				return addresses;
+
+			AddressFamily preferred_family = addresses.front().address_family();
+			AddressesT preferred, others, interleaved;
+
+			for (auto & address : addresses) {
+				if (address.address_family() == preferred_family)
+					preferred.push_back(address);
+				else
+					others.push_back(address);
+			}
+
+			for (std::size_t i = 0; i < preferred.size() || i < others.size(); i += 1) {
+				if (i < preferred.size())
+					interleaved.push_back(preferred[i]);
+
+				if (i < others.size())
+					interleaved.push_back(others[i]);
+			}
+
+			return interleaved;
+		}
+
+		/// A single non-blocking connection attempt, monitored by the runloop until it completes.
+		class ConnectionAttempt : public Socket {
+		public:
+			typedef std::function<void (Events::Loop *, ConnectionAttempt *, int error)> CallbackT;
+
+			Address address;
+			CallbackT callback;
+
+			ConnectionAttempt (const Address & address_) : address(address_) {
+			}
+
+			virtual ~ConnectionAttempt () {
+			}
+
+			/// Start connecting.
+			/// @returns zero if the connection is in progress, otherwise the error.
+			int start () {
+				_socket = ::socket(address.address_family(), address.socket_type(), address.socket_protocol());
+
+				if (_socket == -1)
+					return errno;
+
+				if (fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL, 0) | O_NONBLOCK) == -1)
+					return errno;
+
+				if (::connect(_socket, address.address_data(), address.address_data_size()) == -1 && errno != EINPROGRESS)
+					return errno;
+
+				return 0;
+			}
+
+			/// Give up ownership of the connected socket handle.
+			SocketHandleT release () {
+				SocketHandleT handle = _socket;
+				_socket = -1;
+
+				return handle;
+			}
+
+			virtual void process_events (Events::Loop * event_loop, Events::Event events) {
+				int error = socket_specific_error();
+
+				// The socket becomes writable once the connection completes, successfully or not.
+				if (error || (events & Events::WRITE_READY))
+					callback(event_loop, this, error);
+			}
+		};
+
+		class ClientSocket::Connector : public Object {
+		protected:
+			Ref<ClientSocket> _client_socket;
+			AddressesT _addresses;
+			ConnectCallbackT _callback;
+			TimeT _attempt_delay;
+
+			std::size_t _next_address = 0;
+			std::vector<Ref<ConnectionAttempt>> _attempts;
+			Ref<Events::TimerSource> _timer;
+
+			int _error = ECONNREFUSED;
+			bool _finished = false;
+
+		public:
+			Connector (Ref<ClientSocket> client_socket, const AddressesT & addresses, ConnectCallbackT callback, TimeT attempt_delay) : _client_socket(client_socket), _addresses(addresses), _callback(callback), _attempt_delay(attempt_delay) {
+			}
+
+			virtual ~Connector () {
+			}
+
+			void start_next_attempt (Events::Loop * event_loop) {
+				Ref<Connector> self = this;
+
+				if (_timer) {
+					_timer->cancel();
+					_timer = NULL;
+				}
+
+				while (_next_address < _addresses.size()) {
+					Ref<ConnectionAttempt> attempt = new ConnectionAttempt(_addresses[_next_address++]);
+
+					int error = attempt->start();
+
+					if (error) {
+						// Move on to the next address straight away.
+						_error = error;
+						continue;
+					}
+
+					attempt->callback = [self](Events::Loop * loop, ConnectionAttempt * source, int result) {
+						self->attempt_completed(loop, source, result);
+					};
+
+					_attempts.push_back(attempt);
+					event_loop->monitor(attempt);
+
+					// Race the next address if this attempt doesn't complete quickly enough.
+					if (_next_address < _addresses.size()) {
+						_timer = new Events::TimerSource([self](Events::Loop * loop, Events::TimerSource *, Events::Event) {
+							if (!self->_finished)
+								self->start_next_attempt(loop);
+						}, _attempt_delay);
+
+						event_loop->schedule_timer(_timer);
+					}
+
+					return;
+				}
+
+				// There are no more addresses to try, so we fail once the outstanding attempts have. This may be within ClientSocket::connect, so the
+				// failure is posted rather than invoking the callback before connect returns.
+				if (_attempts.empty()) {
+					event_loop->post_notification(new Events::NotificationSource([self](Events::Loop * loop, Events::NotificationSource *, Events::Event) {
+						self->finish(loop, nullptr);
+					}));
+				}
+			}
+
+			void attempt_completed (Events::Loop * event_loop, ConnectionAttempt * attempt, int error) {
+				if (_finished)
+					return;
+
+				Ref<ConnectionAttempt> completed = attempt;
+
+				event_loop->stop_monitoring_file_descriptor(completed);
+				_attempts.erase(std::remove_if(_attempts.begin(), _attempts.end(), [&](const Ref<ConnectionAttempt> & other) {
+					return other.get() == attempt;
+				}), _attempts.end());
+
+				if (error == 0) {
+					finish(event_loop, completed);
+				} else {
+					_error = error;
+
+					start_next_attempt(event_loop);
+				}
+			}
+
+			void finish (Events::Loop * event_loop, Ref<ConnectionAttempt> attempt) {
+				_finished = true;
+
+				if (_timer) {
+					_timer->cancel();
+					_timer = NULL;
+				}
+
+				// Abandon any other outstanding attempts, which closes them:
+				for (auto other : _attempts)
+					event_loop->stop_monitoring_file_descriptor(other);
+
+				_attempts.clear();
+
+				if (attempt) {
+					DREAM_ASSERT(!_client_socket->is_valid());
+
+					_client_socket->_socket = attempt->release();
+					_client_socket->_remote_address = attempt->address;
+
+					event_loop->monitor(_client_socket);
+
+					_callback(event_loop, _client_socket.get(), 0);
+				} else {
+					_callback(event_loop, _client_socket.get(), _error);
+				}
+			}
+		};
+
+		void ClientSocket::connect (Events::Loop * event_loop, const AddressesT & addresses, ConnectCallbackT callback, TimeT attempt_delay)
+		{
+			DREAM_ASSERT(!is_valid());
+
+			Ref<Connector> connector = new Connector(this, interleave_address_families(addresses), callback, attempt_delay);
+
+			connector->start_next_attempt(event_loop);
+		}
+
 		void ClientSocket::process_events (Events::Loop * event_loop, Events::Event events)
 		{
 		}
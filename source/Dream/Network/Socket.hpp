@@ -64,12 +64,27 @@ namespace Dream {
 			/// Write data to the socket.
 			std::size_t send (const Core::Buffer & buf, std::size_t offset = 0, int flags = 0);
 
+			/// Write size bytes of data to the socket.
+			std::size_t send (const Byte * data, std::size_t size, int flags = 0);
+
 			/// Read data from the socket.
 			/// Set buffer capacity before calling with buf.reserve(buf.size() + sz to read)
 			/// We won't explicity allocate memory in this function
 			/// @returns 0 when the remote peer has closed its end of the connection
 			std::size_t recv (Core::ResizableBuffer & buf, int flags = 0);
 
+			/// Read at most size bytes of data from the socket into the given memory.
+			std::size_t recv (Byte * data, std::size_t size, int flags = 0);
+
+			/// Write data to the socket, reporting would-block, shutdown and reset as a result rather than throwing.
+			IOResult try_send (const Byte * data, std::size_t size, int flags = 0);
+
+			/// Read data from the socket into the reserved space of the buffer, reporting would-block, shutdown and reset as a result rather than throwing.
+			IOResult try_recv (Core::ResizableBuffer & buf, int flags = 0);
+
+			/// Read at most size bytes of data from the socket, reporting would-block, shutdown and reset as a result rather than throwing.
+			IOResult try_recv (Byte * data, std::size_t size, int flags = 0);
+
 			/// The internal file descriptor handle for the socket.
 			virtual FileDescriptor file_descriptor () const;
 
@@ -78,6 +93,29 @@ namespace Dream {
 			
 			/// Set the socket non-blocking mode.
 			void set_non_blocking(bool value = true);
+
+			/// Enable SO_ZEROCOPY, which allows sends using MSG_ZEROCOPY. Returns false if the platform or socket type doesn't support it.
+			bool set_zero_copy (bool enabled = true);
+
+			/// The maximum number of descriptors which can be passed in a single message.
+			static const std::size_t MAXIMUM_DESCRIPTORS = 253;
+
+			/// Send data along with copies of the given descriptors over a unix-domain socket, using SCM_RIGHTS. At least one byte of data must be
+			/// sent. The descriptors remain open in this process.
+			IOResult try_send_descriptors (const Byte * data, std::size_t size, const FileDescriptor * descriptors, std::size_t count);
+
+			/// Receive data along with up to count descriptors sent by try_send_descriptors(). On return, count is the number of descriptors received,
+			/// which are close-on-exec and owned by the caller. Any descriptors beyond the given count are discarded.
+			IOResult try_receive_descriptors (Byte * data, std::size_t size, FileDescriptor * descriptors, std::size_t & count);
+
+			/// Pass a connected socket and its remote address to another process over a unix-domain socket, e.g. from a front process which accepts
+			/// connections to a worker process. The handle remains open in this process, and would usually be closed once sent. A SOCK_SEQPACKET
+			/// socket keeps each connection in a message of its own.
+			IOResult try_send_connection (SocketHandleT handle, const Address & address);
+
+			/// Receive a connection sent by try_send_connection(). The handle is owned by the caller, and can be used to construct a ClientSocket.
+			/// A malformed message fails with EPROTO.
+			IOResult try_receive_connection (SocketHandleT & handle, Address & address);
 		};
 
 		/** A socket that can be bound to a local address and accept connections.
@@ -86,6 +124,7 @@ namespace Dream {
 		class ServerSocket : public Socket {
 		protected:
 			Address _bound_address;
+			std::size_t _accept_budget = 64;
 
 			/// Bind to the given address.
 			void bind (const Address & address, bool reuse_address = true);
@@ -95,14 +134,27 @@ namespace Dream {
 			void set_reuse_address (bool enabled);
 
 		public:
-			/// Create a socket that is bound to the supplied address.
+			/// Create a socket that is bound to the supplied address. For a unix-domain address, reuse_address removes an existing socket at the same
+			/// path, such as one left behind by a previous process, rather than setting SO_REUSEADDR.
 			/// @sa Address::interface_addresses_for
+			/// @sa Address::unix_address
 			ServerSocket (const Address &server_address, unsigned listen_count = 1000, bool reuse_address = true);
+
+			/// Adopt an existing listening socket, such as one inherited from another process. The bound address is taken from the socket, which is
+			/// made non-blocking and closed when this instance is destroyed.
+			explicit ServerSocket (SocketHandleT h);
 			virtual ~ServerSocket ();
 
 			/// Accept an incoming connection request. These details are then supplied to a ClientSocket to create a working connection.
+			/// The accepted socket handle is non-blocking and close-on-exec.
+			/// @returns false if there are no pending connections.
 			bool accept (SocketHandleT & h, Address & na);
 
+			/// The maximum number of connections accepted per READ_READY event, so that other sources on the runloop are still serviced while
+			/// connections are arriving quickly. Remaining connections are accepted on subsequent iterations of the runloop. Zero means no limit.
+			void set_accept_budget (std::size_t budget) { _accept_budget = budget; }
+			std::size_t accept_budget () const { return _accept_budget; }
+
 			/// Returns the address the socket is bound to.
 			const Address & bound_address () const;
 
@@ -122,7 +174,14 @@ namespace Dream {
 		protected:
 			Address _remote_address;
 
+			/// Manages the connection attempts made by the asynchronous connect().
+			class Connector;
+
 		public:
+			/// Called when an asynchronous connect() completes. The error is zero if the socket is now connected, otherwise it is the error from the
+			/// last attempt which failed.
+			typedef std::function<void (Events::Loop *, ClientSocket *, int error)> ConnectCallbackT;
+
 			/// Construct a client socket from an incoming connection from the given address.
 			/// @sa ServerSocket::accept
 			ClientSocket(const SocketHandleT & h, const Address & address);
@@ -144,6 +203,15 @@ namespace Dream {
 			/// @returns true if successfully connected.
 			bool connect (const AddressesT & addresses);
 
+			/// Connect to one of the given addresses without blocking the runloop, racing attempts as described by RFC 8305 (Happy Eyeballs).
+			/// Address families are interleaved, and a new non-blocking attempt is started every attempt_delay seconds, or as soon as the previous
+			/// attempt fails. The first attempt to succeed is adopted by this socket, which is then monitored by the runloop, and the others are
+			/// abandoned. The callback is invoked on the runloop once connected, or once every attempt has failed.
+			void connect (Events::Loop * event_loop, const AddressesT & addresses, ConnectCallbackT callback, TimeT attempt_delay = 0.25);
+
+			/// Reorder addresses so that address families alternate, starting with the family of the first address.
+			static AddressesT interleave_address_families (const AddressesT & addresses);
+
 			/// Handle incoming events for the socket.
 			virtual void process_events (Events::Loop *, Events::Event);
 		};
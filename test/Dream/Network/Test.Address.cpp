@@ -11,6 +11,12 @@
 #include <Dream/Network/Address.hpp>
 #include <Dream/Core/Logger.hpp>
 
+#include <chrono>
+#include <cstring>
+#include <set>
+#include <stdexcept>
+#include <unordered_set>
+
 namespace Dream
 {
 	namespace Network
@@ -52,6 +58,123 @@ namespace Dream
 					examiner.expect(addrs3.size()) > 0;
 				}
 			},
+			
+			{"it should format numeric addresses without allocating",
+				[](UnitTest::Examiner & examiner) {
+					Address ipv4 = Address::addresses_for_name("127.0.0.1", "8080", SOCK_STREAM).at(0);
+					Address ipv6 = Address::addresses_for_name("::1", "80", SOCK_STREAM).at(0);
+					
+					char buffer[Address::MAXIMUM_NUMERIC_LENGTH];
+					
+					examiner << "IPv4 address is formatted with port.";
+					examiner.expect(ipv4.format_numeric(buffer, sizeof(buffer))) == std::strlen("127.0.0.1:8080");
+					examiner.expect(std::string(buffer)) == "127.0.0.1:8080";
+					
+					examiner << "IPv6 address is bracketed.";
+					examiner.expect(ipv6.format_numeric(buffer, sizeof(buffer))) == std::strlen("[::1]:80");
+					examiner.expect(std::string(buffer)) == "[::1]:80";
+					
+					examiner << "Port number is read directly from the address.";
+					examiner.expect(ipv4.port_number()) == 8080;
+					
+					examiner << "Description matches numeric format.";
+					examiner.expect(ipv4.description()) == "127.0.0.1:8080";
+					examiner.expect(ipv6.canonical_numeric_name()) == "::1";
+					
+					examiner << "Buffer which is too small fails cleanly.";
+					examiner.expect(ipv4.format_numeric(buffer, 8)) == 0;
+					examiner.expect(std::string(buffer)) == "";
+				}
+			},
+			
+			{"it should format numeric addresses faster than getnameinfo",
+				[](UnitTest::Examiner & examiner) {
+					typedef std::chrono::steady_clock ClockT;
+					const std::size_t count = 100000;
+					
+					Address address = Address::addresses_for_name("::1", "80", SOCK_STREAM).at(0);
+					std::size_t total = 0;
+					
+					auto start = ClockT::now();
+					
+					for (std::size_t i = 0; i < count; i += 1) {
+						char host[NI_MAXHOST], service[NI_MAXSERV];
+						
+						getnameinfo(address.address_data(), address.address_data_size(), host, sizeof(host), service, sizeof(service), NI_NUMERICHOST | NI_NUMERICSERV);
+						total += std::strlen(host) + std::strlen(service);
+					}
+					
+					auto getnameinfo_duration = std::chrono::duration<double>(ClockT::now() - start).count();
+					
+					start = ClockT::now();
+					
+					for (std::size_t i = 0; i < count; i += 1) {
+						char buffer[Address::MAXIMUM_NUMERIC_LENGTH];
+						
+						total += address.format_numeric(buffer, sizeof(buffer));
+					}
+					
+					auto format_numeric_duration = std::chrono::duration<double>(ClockT::now() - start).count();
+					
+					log("getnameinfo:", (count / getnameinfo_duration), "addresses/s", "format_numeric:", (count / format_numeric_duration), "addresses/s", "checksum:", total);
+					
+					examiner << "Direct formatting is faster than getnameinfo.";
+					examiner.expect(format_numeric_duration) < getnameinfo_duration;
+				}
+			},
+			
+			{"it should compare and hash addresses",
+				[](UnitTest::Examiner & examiner) {
+					Address a = Address::addresses_for_name("127.0.0.1", "80", SOCK_STREAM).at(0);
+					Address b = Address::addresses_for_name("127.0.0.1", "80", SOCK_STREAM).at(0);
+					Address c = Address::addresses_for_name("127.0.0.2", "80", SOCK_STREAM).at(0);
+					Address d = Address::addresses_for_name("127.0.0.1", "81", SOCK_STREAM).at(0);
+					
+					examiner << "Same host and port are equal.";
+					examiner.check(a == b);
+					examiner.expect(a.hash()) == b.hash();
+					
+					examiner << "Different host or port are not equal.";
+					examiner.check(a != c);
+					examiner.check(a != d);
+					
+					examiner << "Addresses are ordered by host then port.";
+					examiner.check(a < d);
+					examiner.check(d < c);
+					examiner.check(!(a < b) && !(b < a));
+					
+					std::set<Address> ordered {a, b, c, d};
+					std::unordered_set<Address> unordered {a, b, c, d};
+					
+					examiner.expect(ordered.size()) == 3;
+					examiner.expect(unordered.size()) == 3;
+				}
+			},
+			
+			{"it should construct unix-domain addresses",
+				[](UnitTest::Examiner & examiner) {
+					Address address = Address::unix_address("/tmp/dream.sock", SOCK_SEQPACKET);
+					
+					examiner.check(address.is_unix());
+					examiner.expect(address.socket_type()) == SOCK_SEQPACKET;
+					examiner.expect(address.unix_path()) == "/tmp/dream.sock";
+					examiner.expect(address.description()) == "/tmp/dream.sock";
+					examiner.expect(address.port_number()) == 0;
+					
+					examiner << "Paths which don't fit in sockaddr_un are rejected.";
+					examiner.expect([&](){
+						Address::unix_address(std::string(200, 'x'));
+					}).to_throw<std::invalid_argument>();
+					
+#ifdef __linux__
+					Address abstract = Address::unix_address("@dream", SOCK_STREAM);
+					
+					examiner << "Abstract names are written with a leading '@'.";
+					examiner.expect(abstract.unix_path()) == "@dream";
+					examiner.check(abstract != Address::unix_address("@dream2", SOCK_STREAM));
+#endif
+				}
+			},
 		};
 	}
 }
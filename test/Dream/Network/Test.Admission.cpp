@@ -0,0 +1,107 @@
+//
+//  Test.Admission.cpp
+//  This file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include <UnitTest/UnitTest.hpp>
+
+#include <Dream/Network/Admission.hpp>
+
+namespace Dream
+{
+	namespace Network
+	{
+		static Address address_for (const char * host, const char * service = "1234")
+		{
+			return Address::addresses_for_name(host, service, SOCK_STREAM).at(0);
+		}
+		
+		UnitTest::Suite AdmissionTestSuite {
+			"Dream::Network::AdmissionControl",
+			
+			{"it should admit everything without limits",
+				[](UnitTest::Examiner & examiner) {
+					AdmissionControl admission_control;
+					
+					examiner.check(!admission_control.is_enabled());
+					
+					for (std::size_t i = 0; i < 100; i += 1)
+						examiner.check(admission_control.admit(address_for("127.0.0.1")));
+					
+					examiner.expect(admission_control.admitted_count()) == 100;
+					examiner.expect(admission_control.rejected_count()) == 0;
+				}
+			},
+			
+			{"it should limit the rate per address",
+				[](UnitTest::Examiner & examiner) {
+					AdmissionControl admission_control;
+					admission_control.set_address_limit(1, 2);
+					
+					examiner << "Burst is admitted, regardless of remote port.";
+					examiner.check(admission_control.admit(address_for("10.0.0.1", "1000"), 0));
+					examiner.check(admission_control.admit(address_for("10.0.0.1", "1001"), 0));
+					examiner.check(!admission_control.admit(address_for("10.0.0.1", "1002"), 0));
+					
+					examiner << "Other hosts have their own bucket.";
+					examiner.check(admission_control.admit(address_for("10.0.0.2"), 0));
+					
+					examiner << "Bucket refills over time.";
+					examiner.check(admission_control.admit(address_for("10.0.0.1"), 1.0));
+					examiner.check(!admission_control.admit(address_for("10.0.0.1"), 1.0));
+					
+					examiner.expect(admission_control.admitted_count()) == 4;
+					examiner.expect(admission_control.rejected_count()) == 2;
+					examiner.expect(admission_control.tracked_address_count()) == 2;
+				}
+			},
+			
+			{"it should limit the rate per prefix and globally",
+				[](UnitTest::Examiner & examiner) {
+					AdmissionControl admission_control;
+					
+					examiner.check(admission_control.set_prefix_limit("192.168.0.0/16", 1, 1));
+					examiner.check(admission_control.set_prefix_limit("172.16.0.0/12", 0, 0));
+					admission_control.set_global_limit(10, 3);
+					
+					examiner << "Hosts in a prefix share a bucket.";
+					examiner.check(admission_control.admit(address_for("192.168.1.1"), 0));
+					examiner.check(!admission_control.admit(address_for("192.168.2.2"), 0));
+					
+					examiner << "Prefix with no rate denies everything.";
+					examiner.check(!admission_control.admit(address_for("172.16.0.1"), 0));
+					
+					examiner << "Global limit applies to everything else.";
+					examiner.check(admission_control.admit(address_for("8.8.8.8"), 0));
+					examiner.check(admission_control.admit(address_for("8.8.4.4"), 0));
+					examiner.check(!admission_control.admit(address_for("1.1.1.1"), 0));
+				}
+			},
+			
+			{"it should bound the number of tracked addresses",
+				[](UnitTest::Examiner & examiner) {
+					AdmissionControl admission_control;
+					admission_control.set_address_limit(1, 2);
+					admission_control.maximum_tracked_addresses = 16;
+					
+					// None of these buckets have refilled, so pruning can't make room for the next host:
+					for (std::size_t i = 0; i < 256; i += 1) {
+						std::string host = "10.0.0." + std::to_string(i);
+						
+						examiner.check(admission_control.admit(address_for(host.c_str()), 0));
+					}
+					
+					examiner << "The table didn't grow beyond its maximum size.";
+					examiner.expect(admission_control.tracked_address_count()) == 16;
+					
+					examiner << "Hosts whose buckets have refilled are forgotten.";
+					examiner.check(admission_control.admit(address_for("10.1.0.1"), 10));
+					examiner.expect(admission_control.tracked_address_count()) == 1;
+				}
+			},
+		};
+	}
+}
@@ -11,6 +11,8 @@
 #include <Dream/Network/Socket.hpp>
 #include <Dream/Core/Logger.hpp>
 
+#include <sys/socket.h>
+
 namespace Dream
 {
 	namespace Network
@@ -147,6 +149,120 @@ namespace Dream
 					examiner.expect(global_incoming_message) == global_message;
 				}
 			},
+			
+			{"it should report would-block and shutdown without throwing",
+				[](UnitTest::Examiner & examiner) {
+					SocketHandleT handles[2];
+					::socketpair(AF_UNIX, SOCK_STREAM, 0, handles);
+
+					Ref<ClientSocket> local = new ClientSocket(handles[0], Address());
+					Ref<ClientSocket> remote = new ClientSocket(handles[1], Address());
+
+					local->set_non_blocking(true);
+
+					Byte buffer[16];
+
+					examiner << "Nothing to read would block.";
+					examiner.check(local->try_recv(buffer, sizeof(buffer)).would_block());
+
+					Byte data[] = "data";
+					examiner << "Data was sent.";
+					examiner.expect(remote->try_send(data, 4).size) == 4;
+
+					IOResult result = local->try_recv(buffer, sizeof(buffer));
+					examiner << "Data was received.";
+					examiner.check(result.is_ok());
+					examiner.expect(result.size) == 4;
+
+					remote->shutdown();
+
+					examiner << "Shutdown is reported as closed.";
+					examiner.check(local->try_recv(buffer, sizeof(buffer)).status == IOStatus::CLOSED);
+
+					examiner << "The throwing variant still throws.";
+					examiner.expect([&](){
+						local->recv(buffer, sizeof(buffer));
+					}).to_throw<ConnectionShutdown>();
+				}
+			},
+			
+			{"it should connect asynchronously, skipping failed addresses",
+				[](UnitTest::Examiner & examiner) {
+					Ref<Events::Loop> event_loop = new Events::Loop;
+					
+					Address listening_address = Address::addresses_for_name("127.1", "2010", SOCK_STREAM)[0];
+					Ref<ServerSocket> server_socket = new ServerSocket(listening_address);
+					
+					// Nothing is listening on the first address, so that attempt will be refused.
+					AddressesT addresses = Address::addresses_for_name("127.1", "2011", SOCK_STREAM);
+					addresses.push_back(listening_address);
+					
+					bool completed = false;
+					int connect_error = -1;
+					
+					Ref<ClientSocket> client_socket = new ClientSocket;
+					client_socket->connect(event_loop.get(), addresses, [&](Events::Loop * loop, ClientSocket * socket, int error) {
+						completed = true;
+						connect_error = error;
+						
+						loop->stop();
+					});
+					
+					event_loop->schedule_timer(new Events::TimerSource(stop_callback, 2));
+					event_loop->run_forever();
+					
+					examiner << "Connection completed.";
+					examiner.check(completed);
+					examiner.expect(connect_error) == 0;
+					
+					examiner << "Socket is connected to the listening address.";
+					examiner.check(client_socket->is_connected());
+					examiner.expect(client_socket->remote_address().port_number()) == 2010;
+				}
+			},
+			
+			{"it should report failure on the runloop when there are no addresses",
+				[](UnitTest::Examiner & examiner) {
+					Ref<Events::Loop> event_loop = new Events::Loop;
+					
+					bool completed = false;
+					int connect_error = 0;
+					
+					Ref<ClientSocket> client_socket = new ClientSocket;
+					client_socket->connect(event_loop.get(), AddressesT(), [&](Events::Loop * loop, ClientSocket * socket, int error) {
+						completed = true;
+						connect_error = error;
+						
+						loop->stop();
+					});
+					
+					examiner << "Callback isn't invoked before connect returns.";
+					examiner.check(!completed);
+					
+					event_loop->schedule_timer(new Events::TimerSource(stop_callback, 2));
+					event_loop->run_forever();
+					
+					examiner << "Failure was reported by the runloop.";
+					examiner.check(completed);
+					examiner.expect(connect_error) != 0;
+					examiner.check(!client_socket->is_connected());
+				}
+			},
+			
+			{"it should interleave address families",
+				[](UnitTest::Examiner & examiner) {
+					Address ipv6 = Address::addresses_for_name("::1", "2010", SOCK_STREAM)[0];
+					Address ipv4 = Address::addresses_for_name("127.0.0.1", "2010", SOCK_STREAM)[0];
+					
+					AddressesT interleaved = ClientSocket::interleave_address_families({ipv6, ipv6, ipv4, ipv4});
+					
+					examiner.expect(interleaved.size()) == 4;
+					examiner.expect(interleaved[0].address_family()) == AF_INET6;
+					examiner.expect(interleaved[1].address_family()) == AF_INET;
+					examiner.expect(interleaved[2].address_family()) == AF_INET6;
+					examiner.expect(interleaved[3].address_family()) == AF_INET;
+				}
+			},
 		};
 	}
 }
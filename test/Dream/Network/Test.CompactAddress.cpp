@@ -0,0 +1,98 @@
+//
+//  Test.CompactAddress.cpp
+//  This file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include <UnitTest/UnitTest.hpp>
+
+#include <Dream/Network/CompactAddress.hpp>
+
+#include <unordered_set>
+#include <cstring>
+
+#include <sys/un.h>
+
+namespace Dream
+{
+	namespace Network
+	{
+		UnitTest::Suite CompactAddressTestSuite {
+			"Dream::Network::CompactAddress",
+			
+			{"it should be smaller than an address",
+				[](UnitTest::Examiner & examiner) {
+					examiner << "Compact address is less than a third of the size.";
+					examiner.expect(sizeof(CompactAddress) * 3) < sizeof(Address);
+				}
+			},
+			
+			{"it should convert to and from an address",
+				[](UnitTest::Examiner & examiner) {
+					for (auto & address : Address::addresses_for_name("localhost", "8080", SOCK_STREAM)) {
+						CompactAddress compact_address(address);
+						
+						examiner << "Internet addresses are stored inline.";
+						examiner.check(compact_address.is_inline());
+						examiner.expect(compact_address.address_data_size()) == address.address_data_size();
+						examiner.expect(compact_address.port_number()) == 8080;
+						
+						Address expanded_address = compact_address.to_address();
+						
+						examiner << "Expanded address is the same.";
+						examiner.expect(expanded_address.description()) == address.description();
+						examiner.expect(expanded_address.socket_type()) == address.socket_type();
+						examiner.expect(expanded_address.socket_protocol()) == address.socket_protocol();
+					}
+				}
+			},
+			
+			{"it should store long unix paths out of line",
+				[](UnitTest::Examiner & examiner) {
+					sockaddr_un unix_address;
+					memset(&unix_address, 0, sizeof(unix_address));
+					
+					unix_address.sun_family = AF_UNIX;
+					strcpy(unix_address.sun_path, "/tmp/dream-network-compact-address-test.sock");
+					
+					std::size_t size = offsetof(sockaddr_un, sun_path) + strlen(unix_address.sun_path) + 1;
+					CompactAddress compact_address((const sockaddr *)&unix_address, size);
+					
+					examiner << "Long path doesn't fit inline.";
+					examiner.check(!compact_address.is_inline());
+					
+					CompactAddress copy = compact_address;
+					
+					examiner << "Copy is equal.";
+					examiner.check(copy == compact_address);
+					examiner.expect(std::string(((const sockaddr_un *)copy.address_data())->sun_path)) == unix_address.sun_path;
+				}
+			},
+			
+			{"it should key a hash table",
+				[](UnitTest::Examiner & examiner) {
+					std::unordered_set<CompactAddress> table;
+					
+					for (auto & address : Address::addresses_for_name("127.0.0.1", "80", SOCK_STREAM))
+						table.insert(address);
+					
+					for (auto & address : Address::addresses_for_name("127.0.0.1", "80", SOCK_STREAM))
+						table.insert(address);
+					
+					examiner << "Duplicate addresses are equal.";
+					examiner.expect(table.size()) == 1;
+					
+					table.insert(Address::addresses_for_name("127.0.0.1", "81", SOCK_STREAM).at(0));
+					
+					examiner << "Different ports are not equal.";
+					examiner.expect(table.size()) == 2;
+					
+					examiner << "Address can be found.";
+					examiner.check(table.count(Address::addresses_for_name("127.0.0.1", "81", SOCK_STREAM).at(0)) == 1);
+				}
+			},
+		};
+	}
+}
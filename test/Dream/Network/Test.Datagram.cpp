@@ -0,0 +1,208 @@
+//
+//  Test.Datagram.cpp
+//  This file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include <UnitTest/UnitTest.hpp>
+
+#include <Dream/Network/Datagram.hpp>
+#include <Dream/Core/Logger.hpp>
+
+#include <chrono>
+#include <cstring>
+
+namespace Dream
+{
+	namespace Network
+	{
+		using namespace Core::Logging;
+		
+		static Address loopback_address ()
+		{
+			return Address::addresses_for_name("127.0.0.1", "0", SOCK_DGRAM).at(0);
+		}
+		
+		UnitTest::Suite DatagramTestSuite {
+			"Dream::Network::DatagramSocket",
+			
+			{"it should send and receive a batch of datagrams",
+				[](UnitTest::Examiner & examiner) {
+					Ref<DatagramSocket> receiver = new DatagramSocket(loopback_address(), 8, 64);
+					Ref<DatagramSocket> sender = new DatagramSocket(loopback_address(), 8, 64);
+					
+					Address destination = receiver->local_address();
+					
+					examiner << "Kernel assigned a port.";
+					examiner.expect(destination.port_number()) != 0;
+					
+					for (std::size_t i = 0; i < 8; i += 1) {
+						Byte data[4] = {'d', 'g', 'm', Byte('0' + i)};
+						examiner.check(sender->queue(data, sizeof(data), destination));
+					}
+					
+					examiner << "Batch is full.";
+					examiner.check(!sender->queue((const Byte *)"x", 1, destination));
+					
+					examiner.expect(sender->flush()) == 8;
+					examiner.expect(sender->queued_count()) == 0;
+					
+					examiner << "All datagrams were received in one batch.";
+					examiner.expect(receiver->receive()) == 8;
+					
+					for (std::size_t i = 0; i < receiver->received_count(); i += 1) {
+						const Datagram & datagram = receiver->received_datagram(i);
+						
+						examiner.expect(datagram.size) == 4;
+						examiner.expect(datagram.data[3]) == Byte('0' + i);
+						examiner.check(!datagram.truncated);
+						examiner.check(datagram.address == sender->local_address());
+					}
+					
+					examiner << "Nothing more is waiting.";
+					examiner.expect(receiver->receive()) == 0;
+				}
+			},
+			
+			{"it should mark datagrams larger than the maximum size as truncated",
+				[](UnitTest::Examiner & examiner) {
+					Ref<DatagramSocket> receiver = new DatagramSocket(loopback_address(), 4, 16);
+					Ref<DatagramSocket> sender = new DatagramSocket(loopback_address(), 4, 64);
+					
+					Byte data[32];
+					std::memset(data, 'x', sizeof(data));
+					
+					sender->queue(data, sizeof(data), receiver->local_address());
+					sender->flush();
+					
+					examiner.expect(receiver->receive()) == 1;
+					examiner.check(receiver->received_datagram(0).truncated);
+				}
+			},
+			
+			{"it should transfer datagrams quickly over loopback",
+				[](UnitTest::Examiner & examiner) {
+					const std::size_t batch_size = 64, batch_count = 2000;
+					
+					Ref<DatagramSocket> receiver = new DatagramSocket(loopback_address(), batch_size, 256);
+					Ref<DatagramSocket> sender = new DatagramSocket(loopback_address(), batch_size, 256);
+					
+					Address destination = receiver->local_address();
+					Byte data[64];
+					std::memset(data, 'b', sizeof(data));
+					
+					std::size_t sent = 0, received = 0;
+					auto start = std::chrono::steady_clock::now();
+					
+					for (std::size_t batch = 0; batch < batch_count; batch += 1) {
+						for (std::size_t i = 0; i < batch_size; i += 1)
+							sender->queue(data, sizeof(data), destination);
+						
+						while (sender->queued_count() > 0)
+							sent += sender->flush();
+						
+						// Keep up with the sender so that the receive buffer doesn't overflow:
+						while (std::size_t count = receiver->receive())
+							received += count;
+					}
+					
+					double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					
+					log("Sent", sent, "datagrams and received", received, "in", duration, "seconds:", (received / duration), "datagrams/s");
+					
+					examiner << "Datagrams were sent and received.";
+					examiner.expect(sent) == batch_size * batch_count;
+					examiner.expect(received) > (sent * 9) / 10;
+				}
+			},
+			
+			{"it should present segmented and coalesced datagrams individually",
+				[](UnitTest::Examiner & examiner) {
+					Ref<DatagramSocket> receiver = new DatagramSocket(loopback_address(), 64, 1500);
+					Ref<DatagramSocket> sender = new DatagramSocket(loopback_address(), 64, 1500);
+					
+					if (!sender->set_segmentation_offload() || !receiver->set_receive_offload()) {
+						examiner << "Segmentation offload is not supported, skipping.";
+						return;
+					}
+					
+					Address destination = receiver->local_address();
+					Byte data[1200];
+					
+					// The short datagrams end each run of segments.
+					for (std::size_t i = 0; i < 64; i += 1) {
+						std::size_t size = (i == 40 || i == 63) ? 500 : 1200;
+						std::memset(data, Byte(i), size);
+						
+						sender->queue(data, size, destination);
+					}
+					
+					examiner.expect(sender->flush()) == 64;
+					
+					examiner << "Datagrams were sent as two runs of segments, unless the kernel fell back.";
+					if (sender->segmentation_offload())
+						examiner.expect(sender->segmented_send_count()) == 2;
+					
+					std::size_t received = 0;
+					
+					while (std::size_t count = receiver->receive()) {
+						for (std::size_t i = 0; i < count; i += 1, received += 1) {
+							const Datagram & datagram = receiver->received_datagram(i);
+							
+							examiner.expect(datagram.size) == ((received == 40 || received == 63) ? 500 : 1200);
+							examiner.expect(datagram.data[0]) == Byte(received);
+							examiner.expect(datagram.data[datagram.size - 1]) == Byte(received);
+							examiner.check(datagram.address == sender->local_address());
+						}
+					}
+					
+					examiner << "All datagrams were received in order.";
+					examiner.expect(received) == 64;
+				}
+			},
+			
+			{"it should transfer bulk datagrams quickly with segmentation offload",
+				[](UnitTest::Examiner & examiner) {
+					const std::size_t batch_size = 64, batch_count = 500, size = 1200;
+					
+					for (bool offload : {false, true}) {
+						Ref<DatagramSocket> receiver = new DatagramSocket(loopback_address(), batch_size, size);
+						Ref<DatagramSocket> sender = new DatagramSocket(loopback_address(), batch_size, size);
+						
+						if (offload && (!sender->set_segmentation_offload() || !receiver->set_receive_offload())) {
+							examiner << "Segmentation offload is not supported, skipping.";
+							return;
+						}
+						
+						Address destination = receiver->local_address();
+						Byte data[size];
+						std::memset(data, 'b', sizeof(data));
+						
+						std::size_t sent = 0, received = 0;
+						auto start = std::chrono::steady_clock::now();
+						
+						for (std::size_t batch = 0; batch < batch_count; batch += 1) {
+							for (std::size_t i = 0; i < batch_size; i += 1)
+								sender->queue(data, sizeof(data), destination);
+							
+							while (sender->queued_count() > 0)
+								sent += sender->flush();
+							
+							while (std::size_t count = receiver->receive())
+								received += count;
+						}
+						
+						double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+						
+						log(offload ? "With" : "Without", "offload, sent", sent, "datagrams and received", received, "in", duration, "seconds:", (received / duration), "datagrams/s");
+						
+						examiner.expect(sent) == batch_size * batch_count;
+						examiner.expect(received) > (sent * 9) / 10;
+					}
+				}
+			},
+		};
+	}
+}
@@ -10,6 +10,9 @@
 
 #include <Dream/Network/Message.hpp>
 
+#include <sys/socket.h>
+#include <cerrno>
+
 namespace Dream
 {
 	namespace Network
@@ -48,6 +51,264 @@ namespace Dream
 					examiner.check(m1->data_complete());
 				}
 			},
+
+			{"it should have a compact header",
+				[](UnitTest::Examiner & examiner) {
+					Ref<Message> m1(new Message);
+					m1->reset_header();
+
+					examiner << "Packed header is 6 bytes." << std::endl;
+					examiner.expect(m1->header_length()) == 6;
+					examiner.expect(m1->header_length(MessageFraming::PACKED)) == 6;
+
+					examiner << "Varint header for an empty message is 2 bytes." << std::endl;
+					examiner.expect(m1->header_length(MessageFraming::VARINT)) == 2;
+				}
+			},
+
+			{"it should encode and decode varint headers",
+				[](UnitTest::Examiner & examiner) {
+					Ref<Message> m1(new Message);
+					m1->reset_header();
+					m1->header()->packet_type = 0xDEAD;
+
+					MsgTest body;
+					for (std::size_t i = 0; i < 100; i += 1)
+						m1->insert(body);
+
+					Byte buffer[Message::MAXIMUM_VARINT_HEADER_LENGTH];
+					std::size_t header_length = m1->encode_header(MessageFraming::VARINT, buffer);
+
+					examiner << "Header uses 2 bytes for length and 3 bytes for type." << std::endl;
+					examiner.expect(header_length) == 5;
+
+					uint32_t length = 0;
+					uint16_t packet_type = 0;
+
+					examiner << "Partial header can't be decoded." << std::endl;
+					examiner.expect(Message::decode_varint_header(buffer, buffer + header_length - 1, length, packet_type)) == 0;
+
+					examiner << "Complete header can be decoded." << std::endl;
+					examiner.expect(Message::decode_varint_header(buffer, buffer + header_length, length, packet_type)) == header_length;
+					examiner.expect(length) == m1->data_length();
+					examiner.expect(packet_type) == 0xDEAD;
+				}
+			},
+
+			{"it should reject malformed varint headers",
+				[](UnitTest::Examiner & examiner) {
+					uint32_t length = 0;
+					uint16_t packet_type = 0;
+
+					Byte largest[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0xFF, 0xFF, 0x03};
+					examiner << "Largest length and packet type can be decoded." << std::endl;
+					examiner.expect(Message::decode_varint_header(largest, largest + sizeof(largest), length, packet_type)) == sizeof(largest);
+					examiner.expect(length) == 0xFFFFFFFF;
+					examiner.expect(packet_type) == 0xFFFF;
+
+					Byte long_length[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x1F, 0x00};
+					examiner << "Length which doesn't fit in 32 bits is malformed." << std::endl;
+					examiner.check(Message::decode_varint_header(long_length, long_length + sizeof(long_length), length, packet_type) == Message::MALFORMED_HEADER);
+
+					Byte long_type[] = {0x00, 0xFF, 0xFF, 0x07};
+					examiner << "Packet type which doesn't fit in 16 bits is malformed." << std::endl;
+					examiner.check(Message::decode_varint_header(long_type, long_type + sizeof(long_type), length, packet_type) == Message::MALFORMED_HEADER);
+
+					SocketHandleT handles[2];
+					::socketpair(AF_UNIX, SOCK_STREAM, 0, handles);
+
+					Ref<ClientSocket> sender = new ClientSocket(handles[0], Address());
+					Ref<ClientSocket> receiver = new ClientSocket(handles[1], Address());
+
+					// A length which never terminates:
+					BufferT data;
+					data.resize(16);
+					std::memset(&data[0], 0x80, data.size());
+
+					sender->send(data);
+
+					MessageReceiver message_receiver(MessageFraming::VARINT);
+					MessageQueueT messages;
+					IOResult result;
+
+					examiner << "Over-long header is reported as a protocol error." << std::endl;
+					examiner.expect(message_receiver.receive_from_socket(receiver.get(), messages, result)) == 0;
+					examiner.check(result.status == IOStatus::FAILED);
+					examiner.expect(result.error) == EPROTO;
+				}
+			},
+
+			{"it should recycle message buffers from a pool",
+				[](UnitTest::Examiner & examiner) {
+					Ref<MessagePool> pool = new MessagePool(4);
+
+					{
+						Ref<Message> m1 = pool->allocate();
+						m1->reset_header();
+
+						MsgTest body;
+						m1->insert(body);
+					}
+
+					examiner << "Released buffer is retained by the pool." << std::endl;
+					examiner.expect(pool->size()) == 1;
+					examiner.expect(pool->miss_count()) == 1;
+
+					Ref<Message> m2 = pool->allocate();
+
+					examiner << "Buffer was reused and is empty." << std::endl;
+					examiner.expect(pool->hit_count()) == 1;
+					examiner.expect(m2->packet().size()) == 0;
+					examiner.expect(m2->packet().capacity()) >= (m2->header_length() + sizeof(MsgTest));
+					examiner.expect(pool->hit_rate()) == 0.5;
+				}
+			},
+
+			{"it should receive several messages with a single read",
+				[](UnitTest::Examiner & examiner) {
+					SocketHandleT handles[2];
+					::socketpair(AF_UNIX, SOCK_STREAM, 0, handles);
+
+					Ref<ClientSocket> sender = new ClientSocket(handles[0], Address());
+					Ref<ClientSocket> receiver = new ClientSocket(handles[1], Address());
+
+					// Three messages and the first two bytes of a fourth header:
+					BufferT data;
+					auto append = [&](std::size_t size, const Byte * begin) {
+						std::size_t offset = data.size();
+						data.resize(offset + size);
+						std::memcpy(&data[offset], begin, size);
+					};
+
+					for (std::size_t i = 0; i < 3; i += 1) {
+						Ref<Message> m1(new Message);
+						m1->reset_header();
+						m1->header()->packet_type = i;
+
+						MsgTest body;
+						m1->insert(body);
+
+						append(m1->packet().size(), m1->packet().begin());
+					}
+
+					Ref<Message> m2(new Message);
+					m2->reset_header();
+					append(2, m2->packet().begin());
+
+					sender->send(data);
+
+					MessageReceiver message_receiver;
+					MessageQueueT messages;
+
+					examiner << "All complete messages were received." << std::endl;
+					examiner.expect(message_receiver.receive_from_socket(receiver.get(), messages)) == 3;
+					examiner.expect(messages.size()) == 3;
+					examiner.expect(messages.back()->header()->packet_type) == 2;
+					examiner.expect(messages.back()->data_length()) == sizeof(MsgTest);
+
+					sender->send(m2->packet(), 2);
+
+					examiner << "Partial header was completed by the next read." << std::endl;
+					examiner.expect(message_receiver.receive_from_socket(receiver.get(), messages)) == 1;
+					examiner.expect(messages.back()->data_length()) == 0;
+				}
+			},
+
+			{"it should only be interested in writing when messages are queued",
+				[](UnitTest::Examiner & examiner) {
+					SocketHandleT handles[2];
+					::socketpair(AF_UNIX, SOCK_STREAM, 0, handles);
+
+					Ref<MessageClientSocket> sender = new MessageClientSocket(handles[0], Address());
+					Ref<MessageClientSocket> receiver = new MessageClientSocket(handles[1], Address());
+
+					examiner << "Idle socket is not interested in writing." << std::endl;
+					examiner.check(!sender->write_interest());
+
+					Ref<Message> m1(new Message);
+					m1->reset_header();
+					sender->send_message(m1);
+
+					examiner << "Queued message arms write interest." << std::endl;
+					examiner.check(sender->write_interest());
+
+					sender->process_events(nullptr, Events::WRITE_READY);
+
+					examiner << "Write interest is disarmed once the queue is drained." << std::endl;
+					examiner.check(!sender->write_interest());
+					examiner.check(!sender->has_messages_to_send());
+
+					receiver->process_events(nullptr, Events::READ_READY);
+
+					examiner << "Message was received." << std::endl;
+					examiner.expect(receiver->received_messages().size()) == 1;
+				}
+			},
+
+			{"it should apply watermarks and limits to the send queue",
+				[](UnitTest::Examiner & examiner) {
+					SocketHandleT handles[2];
+					::socketpair(AF_UNIX, SOCK_STREAM, 0, handles);
+
+					Ref<MessageClientSocket> sender = new MessageClientSocket(handles[0], Address());
+					Ref<MessageClientSocket> receiver = new MessageClientSocket(handles[1], Address());
+
+					struct Payload {
+						Byte data[1000];
+					};
+
+					auto make_message = []() {
+						Ref<Message> message(new Message);
+						message->reset_header();
+
+						Payload payload;
+						std::memset(&payload, 0, sizeof(payload));
+						message->insert(payload);
+
+						return message;
+					};
+
+					std::size_t paused = 0, resumed = 0;
+					sender->send_paused_callback = [&](MessageClientSocket *) {paused += 1;};
+					sender->send_resumed_callback = [&](MessageClientSocket *) {resumed += 1;};
+
+					sender->set_send_watermarks(2000, 4000);
+					sender->set_send_limit(5000, SendLimitPolicy::DROP);
+
+					for (std::size_t i = 0; i < 4; i += 1)
+						examiner.check(sender->send_message(make_message()));
+
+					examiner << "Producer is paused at the high watermark." << std::endl;
+					examiner.check(sender->is_send_paused());
+					examiner.expect(paused) == 1;
+					examiner.expect(sender->queued_bytes()) == 4 * (sizeof(MessageHeader) + sizeof(Payload));
+
+					examiner << "Message beyond the limit is dropped." << std::endl;
+					examiner.check(!sender->send_message(make_message()));
+					examiner.expect(sender->dropped_message_count()) == 1;
+
+					sender->process_events(nullptr, Events::WRITE_READY);
+
+					examiner << "Producer is resumed once the queue drains." << std::endl;
+					examiner.check(!sender->is_send_paused());
+					examiner.expect(resumed) == 1;
+					examiner.expect(sender->queued_bytes()) == 0;
+
+					IOResult disconnected_result;
+					sender->disconnected_callback = [&](MessageClientSocket *, const IOResult & result) {disconnected_result = result;};
+
+					sender->set_send_limit(1500, SendLimitPolicy::DISCONNECT);
+
+					examiner.check(sender->send_message(make_message()));
+					examiner.check(!sender->send_message(make_message()));
+
+					sender->process_events(nullptr, Events::READ_READY);
+
+					examiner << "Exceeding the limit disconnects the socket." << std::endl;
+					examiner.check(disconnected_result.status == IOStatus::FAILED);
+					examiner.expect(disconnected_result.error) == ENOBUFS;
+				}
+			},
 		};
 	}
 }
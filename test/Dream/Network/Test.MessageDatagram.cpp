@@ -0,0 +1,113 @@
+//
+//  Test.MessageDatagram.cpp
+//  This file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include <UnitTest/UnitTest.hpp>
+
+#include <Dream/Network/MessageDatagram.hpp>
+
+namespace Dream
+{
+	namespace Network
+	{
+		static Address loopback_datagram_address ()
+		{
+			return Address::addresses_for_name("127.0.0.1", "0", SOCK_DGRAM).at(0);
+		}
+		
+		static Ref<Message> message_of_size (uint16_t packet_type, std::size_t size)
+		{
+			Ref<Message> message = new Message;
+			message->reset_header();
+			message->header()->packet_type = packet_type;
+			
+			for (std::size_t i = 0; i < size; i += 1) {
+				Byte value = Byte(packet_type + i);
+				message->insert(value);
+			}
+			
+			return message;
+		}
+		
+		UnitTest::Suite MessageDatagramTestSuite {
+			"Dream::Network::MessageDatagramSocket",
+			
+			{"it should pack small messages into datagrams",
+				[](UnitTest::Examiner & examiner) {
+					for (MessageFraming framing : {MessageFraming::PACKED, MessageFraming::VARINT}) {
+						Ref<MessageDatagramSocket> receiver = new MessageDatagramSocket(loopback_datagram_address(), 16, 256);
+						Ref<MessageDatagramSocket> sender = new MessageDatagramSocket(loopback_datagram_address(), 16, 256);
+						
+						receiver->set_framing(framing);
+						sender->set_framing(framing);
+						
+						Address destination = receiver->local_address();
+						
+						examiner << "Oversized messages are rejected.";
+						examiner.check(!sender->send_message(message_of_size(1, 300), destination));
+						
+						for (uint16_t i = 0; i < 20; i += 1)
+							examiner.check(sender->send_message(message_of_size(i, 50), destination));
+						
+						sender->flush_messages();
+						
+						examiner << "Several messages were packed into each datagram.";
+						examiner.expect(sender->packed_message_count()) == 20;
+						examiner.expect(sender->packed_datagram_count()) < 10;
+						
+						receiver->process_events(nullptr, Events::READ_READY);
+						
+						examiner << "All messages were received in order.";
+						examiner.expect(receiver->received_messages().size()) == 20;
+						examiner.expect(receiver->malformed_datagram_count()) == 0;
+						
+						for (uint16_t i = 0; i < 20; i += 1) {
+							Address sender_address;
+							Ref<Message> message;
+							
+							// Popping the queue directly keeps each message with its sender:
+							if (i % 2) {
+								message = receiver->received_messages().front().message;
+								sender_address = receiver->received_messages().front().sender;
+								receiver->received_messages().pop();
+							} else {
+								message = receiver->pop(sender_address);
+							}
+							
+							examiner.expect(message->header()->packet_type) == i;
+							examiner.expect(message->data_length()) == 50;
+							examiner.expect(message->packet()[message->header_length() + 49]) == Byte(i + 49);
+							examiner.check(sender_address == sender->local_address());
+						}
+						
+						examiner.check(!receiver->pop());
+					}
+				}
+			},
+			
+			{"it should discard incomplete messages",
+				[](UnitTest::Examiner & examiner) {
+					Ref<MessageDatagramSocket> receiver = new MessageDatagramSocket(loopback_datagram_address());
+					Ref<DatagramSocket> sender = new DatagramSocket(loopback_datagram_address());
+					
+					// A message header which claims more data than the datagram holds:
+					MessageHeader header;
+					header.length = 100;
+					header.packet_type = 1;
+					
+					sender->queue((const Byte *)&header, sizeof(header), receiver->local_address());
+					sender->flush();
+					
+					receiver->process_events(nullptr, Events::READ_READY);
+					
+					examiner.expect(receiver->received_messages().size()) == 0;
+					examiner.expect(receiver->malformed_datagram_count()) == 1;
+				}
+			},
+		};
+	}
+}
@@ -11,12 +11,55 @@
 #include <Dream/Network/OutputStream.hpp>
 #include <Buffers/StaticBuffer.hpp>
 
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <cstring>
+
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 namespace Dream
 {
 	namespace Network
 	{
+		// Connect a pair of TCP sockets over loopback, as zero-copy isn't supported by pipes or unix sockets.
+		static void tcp_loopback_pair (FileDescriptor & client, FileDescriptor & server)
+		{
+			FileDescriptor listener = ::socket(AF_INET, SOCK_STREAM, 0);
+			
+			sockaddr_in address;
+			socklen_t address_length = sizeof(address);
+			std::memset(&address, 0, sizeof(address));
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			
+			::bind(listener, (sockaddr *)&address, sizeof(address));
+			::listen(listener, 1);
+			::getsockname(listener, (sockaddr *)&address, &address_length);
+			
+			client = ::socket(AF_INET, SOCK_STREAM, 0);
+			::connect(client, (sockaddr *)&address, sizeof(address));
+			server = ::accept(listener, nullptr, nullptr);
+			
+			::close(listener);
+			
+			::fcntl(client, F_SETFL, ::fcntl(client, F_GETFL) | O_NONBLOCK);
+			::fcntl(server, F_SETFL, ::fcntl(server, F_GETFL) | O_NONBLOCK);
+		}
+		
+		class ReleaseTracker : public Object
+		{
+		public:
+			bool * released;
+			
+			ReleaseTracker (bool * released_) : released(released_) {}
+			virtual ~ReleaseTracker () { *released = true; }
+		};
+		
 		UnitTest::Suite OutputStreamTestSuite {
 			"Dream::Network::OutputStream",
 			
@@ -44,6 +87,221 @@ namespace Dream
 					::close(file_descriptors[1]);
 				}
 			},
+			
+			{"it can write several segments with one call",
+				[](UnitTest::Examiner & examiner) {
+					FileDescriptor file_descriptors[2];
+					auto test = Shared<StaticBuffer>::make("test", false);
+					Byte data[] = "data";
+					
+					::pipe(file_descriptors);
+					
+					OutputStream _output_stream;
+					
+					_output_stream.append(test);
+					_output_stream.append_copy(data, 4);
+					_output_stream.append(data, 4, nullptr);
+					
+					examiner << "Writing all segments to the pipe" << std::endl;
+					examiner.expect(_output_stream.write_to(file_descriptors[1])) == 12;
+					examiner.check(_output_stream.empty());
+					
+					Byte buffer[12];
+					examiner << "Reading the data from the pipe" << std::endl;
+					examiner.expect(::read(file_descriptors[0], buffer, 12)) == 12;
+					examiner.expect(std::string(buffer, buffer+12)) == "testdatadata";
+					
+					::close(file_descriptors[0]);
+					::close(file_descriptors[1]);
+				}
+			},
+			
+			{"it can send large segments without copying",
+				[](UnitTest::Examiner & examiner) {
+					FileDescriptor client, server;
+					tcp_loopback_pair(client, server);
+					
+#ifdef SO_ZEROCOPY
+					int enabled = 1;
+					bool supported = ::setsockopt(client, SOL_SOCKET, SO_ZEROCOPY, &enabled, sizeof(enabled)) == 0;
+#else
+					bool supported = false;
+#endif
+					
+					std::vector<Byte> data(1024*1024*4, 'z');
+					bool released = false;
+					
+					OutputStream output_stream;
+					// Without SO_ZEROCOPY, the stream must not use MSG_ZEROCOPY, as MessageClientSocket::set_zero_copy_threshold ensures. The data is then copied as usual.
+					if (supported)
+						output_stream.set_zero_copy_threshold(1024*64);
+					else
+						examiner << "Zero-copy is not supported by this system, checking the copying path." << std::endl;
+					
+					Byte header[] = "head";
+					output_stream.append_copy(header, 4);
+					output_stream.append(data.data(), data.size(), new ReleaseTracker(&released));
+					
+					std::size_t total = 0, expected = data.size() + 4;
+					std::vector<Byte> input(1024*64);
+					
+					auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+					
+					while ((total < expected || output_stream.pending_zero_copy_count()) && std::chrono::steady_clock::now() < deadline) {
+						output_stream.try_write_to(client);
+						output_stream.reap_zero_copy_completions(client);
+						
+						ssize_t count = ::read(server, input.data(), input.size());
+						
+						if (count > 0)
+							total += count;
+					}
+					
+					examiner << "All data was received.";
+					examiner.expect(total) == expected;
+					
+					if (supported) {
+						examiner << "Large segment was sent using zero-copy.";
+						examiner.check(output_stream.zero_copy_count() > 0);
+					} else {
+						examiner.expect(output_stream.zero_copy_count()) == 0;
+					}
+					
+					examiner << "Segment was released once all sends completed.";
+					examiner.expect(output_stream.pending_zero_copy_count()) == 0;
+					examiner.check(released);
+					
+					::close(client);
+					::close(server);
+				}
+			},
+			
+			{"it can write file ranges in order with buffers",
+				[](UnitTest::Examiner & examiner) {
+					char path[] = "/tmp/dream-network-output-stream-XXXXXX";
+					FileDescriptor file = ::mkstemp(path);
+					::unlink(path);
+					
+					const char * contents = "0123456789";
+					examiner.expect(::write(file, contents, 10)) == 10;
+					
+					FileDescriptor file_descriptors[2];
+					::pipe(file_descriptors);
+					
+					OutputStream output_stream;
+					
+					output_stream.append_copy((const Byte *)"<", 1);
+					output_stream.append_file(file, 2, 5);
+					output_stream.append_copy((const Byte *)">", 1);
+					output_stream.append_file(file, 0, 1);
+					
+					while (!output_stream.empty())
+						output_stream.write_to(file_descriptors[1]);
+					
+					Byte buffer[8];
+					examiner << "Reading the data from the pipe" << std::endl;
+					examiner.expect(::read(file_descriptors[0], buffer, 8)) == 8;
+					examiner.expect(std::string(buffer, buffer+8)) == "<23456>0";
+					
+					::close(file);
+					::close(file_descriptors[0]);
+					::close(file_descriptors[1]);
+				}
+			},
+			
+			{"it can write more buffers than IOV_MAX",
+				[](UnitTest::Examiner & examiner) {
+					FileDescriptor file_descriptors[2];
+					::socketpair(AF_UNIX, SOCK_STREAM, 0, file_descriptors);
+					::fcntl(file_descriptors[1], F_SETFL, ::fcntl(file_descriptors[1], F_GETFL) | O_NONBLOCK);
+					
+					const std::uint32_t count = 20000;
+					std::vector<std::uint32_t> values(count);
+					
+					// Each buffer must be a separate iovec:
+					OutputStream output_stream;
+					output_stream.set_coalesce_threshold(0);
+					
+					for (std::uint32_t i = 0; i < count; i += 1) {
+						values[i] = i;
+						output_stream.append((const Byte *)&values[i], sizeof(std::uint32_t), nullptr);
+					}
+					
+					std::vector<std::uint32_t> received;
+					std::size_t partial = 0;
+					std::uint32_t value = 0;
+					
+					while (received.size() < count) {
+						output_stream.write_to(file_descriptors[1]);
+						
+						Byte buffer[1024*16];
+						ssize_t size = ::read(file_descriptors[0], buffer, sizeof(buffer));
+						
+						if (size <= 0)
+							break;
+						
+						for (ssize_t i = 0; i < size; i += 1) {
+							((Byte *)&value)[partial++] = buffer[i];
+							
+							if (partial == sizeof(value)) {
+								received.push_back(value);
+								partial = 0;
+							}
+						}
+					}
+					
+					examiner << "All buffers were written.";
+					examiner.check(output_stream.empty());
+					examiner.expect(received.size()) == count;
+					
+					examiner << "Buffers were written in order.";
+					examiner.check(received == values);
+					
+					::close(file_descriptors[0]);
+					::close(file_descriptors[1]);
+				}
+			},
+			
+			{"it can coalesce small segments",
+				[](UnitTest::Examiner & examiner) {
+					FileDescriptor file_descriptors[2];
+					::socketpair(AF_UNIX, SOCK_STREAM, 0, file_descriptors);
+					
+					OutputStream output_stream;
+					output_stream.set_coalesce_threshold(64);
+					
+					std::vector<Byte> large(1024, 'L');
+					std::string expected;
+					
+					for (std::size_t i = 0; i < 100; i += 1) {
+						Byte value = 'a' + (i % 26);
+						output_stream.append_copy(&value, 1);
+						expected += value;
+					}
+					
+					output_stream.append(large.data(), large.size(), nullptr);
+					expected += std::string(large.begin(), large.end());
+					
+					output_stream.append(Shared<StaticBuffer>::make("tail", false));
+					expected += "tail";
+					
+					examiner << "Small segments were copied and large segments were referenced.";
+					examiner.expect(output_stream.coalesced_bytes()) == 104;
+					examiner.expect(output_stream.referenced_bytes()) == 1024;
+					examiner.expect(output_stream.queued_bytes()) == expected.size();
+					
+					examiner.expect(output_stream.write_to(file_descriptors[1])) == expected.size();
+					
+					std::vector<Byte> buffer(expected.size());
+					examiner.expect(::read(file_descriptors[0], buffer.data(), buffer.size())) == expected.size();
+					
+					examiner << "Data was written in order.";
+					examiner.expect(std::string(buffer.begin(), buffer.end())) == expected;
+					
+					::close(file_descriptors[0]);
+					::close(file_descriptors[1]);
+				}
+			},
 		};
 	}
 }
@@ -0,0 +1,69 @@
+//
+//  Test.PrefixTable.cpp
+//  This file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include <UnitTest/UnitTest.hpp>
+
+#include <Dream/Network/PrefixTable.hpp>
+
+namespace Dream
+{
+	namespace Network
+	{
+		static Address address_for (const char * host)
+		{
+			return Address::addresses_for_name(host, "80", SOCK_STREAM).at(0);
+		}
+		
+		UnitTest::Suite PrefixTableTestSuite {
+			"Dream::Network::PrefixTable",
+			
+			{"it should find the longest matching prefix",
+				[](UnitTest::Examiner & examiner) {
+					PrefixTable<int> table;
+					
+					examiner.check(table.insert("10.0.0.0/8", 1));
+					examiner.check(table.insert("10.1.0.0/16", 2));
+					examiner.check(table.insert("10.1.2.3", 3));
+					examiner.check(table.insert("2001:db8::/32", 4));
+					
+					examiner << "Malformed prefixes are rejected.";
+					examiner.check(!table.insert("10.0.0.0/33", 0));
+					examiner.check(!table.insert("not-an-address/8", 0));
+					
+					examiner.expect(table.size()) == 4;
+					
+					examiner << "Most specific prefix matches.";
+					examiner.expect(*table.lookup(address_for("10.1.2.3"))) == 3;
+					examiner.expect(*table.lookup(address_for("10.1.9.9"))) == 2;
+					examiner.expect(*table.lookup(address_for("10.200.0.1"))) == 1;
+					examiner.expect(*table.lookup(address_for("2001:db8:1::1"))) == 4;
+					
+					examiner << "Unmatched addresses are not found.";
+					examiner.check(table.lookup(address_for("192.168.0.1")) == nullptr);
+					examiner.check(table.lookup(address_for("2001:db9::1")) == nullptr);
+					
+					examiner << "IPv4-mapped addresses match IPv4 prefixes.";
+					examiner.expect(*table.lookup(address_for("::ffff:10.1.2.3"))) == 3;
+				}
+			},
+			
+			{"it should match everything with a default route",
+				[](UnitTest::Examiner & examiner) {
+					PrefixTable<bool> table;
+					
+					table.insert("0.0.0.0/0", true);
+					table.insert("192.168.0.0/16", false);
+					
+					examiner.check(*table.lookup(address_for("8.8.8.8")) == true);
+					examiner.check(*table.lookup(address_for("192.168.1.1")) == false);
+					examiner.check(table.lookup(address_for("::1")) == nullptr);
+				}
+			},
+		};
+	}
+}
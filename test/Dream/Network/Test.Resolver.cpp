@@ -0,0 +1,139 @@
+//
+//  Test.Resolver.cpp
+//  This file is part of the "Dream" project and released under the MIT License.
+//
+//  Created by Samuel Williams on 17/10/2026.
+//  Copyright, 2026, by Samuel Williams. All rights reserved.
+//
+
+#include <UnitTest/UnitTest.hpp>
+
+#include <Dream/Network/Resolver.hpp>
+#include <Dream/Events/Source.hpp>
+
+namespace Dream
+{
+	namespace Network
+	{
+		static void stop_resolver_callback (Events::Loop * event_loop, Events::TimerSource *, Events::Event event)
+		{
+			event_loop->stop();
+		}
+		
+		UnitTest::Suite ResolverTestSuite {
+			"Dream::Network::Resolver",
+			
+			{"it should resolve names asynchronously and cache the results",
+				[](UnitTest::Examiner & examiner) {
+					Ref<Events::Loop> event_loop = new Events::Loop;
+					event_loop->set_stop_when_idle(false);
+					
+					Ref<Resolver> resolver = new Resolver(1);
+					
+					std::size_t completed = 0;
+					AddressesT resolved_addresses;
+					int resolved_error = -1;
+					
+					Resolver::CallbackT callback = [&](Events::Loop * loop, const AddressesT & addresses, int error) {
+						completed += 1;
+						resolved_addresses = addresses;
+						resolved_error = error;
+						
+						if (completed == 2)
+							loop->stop();
+					};
+					
+					// Both requests are made before the first completes, so they share a lookup:
+					resolver->resolve(event_loop.get(), "localhost", "http", SOCK_STREAM, callback);
+					resolver->resolve(event_loop.get(), "localhost", "http", SOCK_STREAM, callback);
+					
+					event_loop->schedule_timer(new Events::TimerSource(stop_resolver_callback, 5));
+					event_loop->run_forever();
+					
+					examiner << "Both requests completed.";
+					examiner.expect(completed) == 2;
+					examiner.expect(resolved_error) == 0;
+					examiner.expect(resolved_addresses.size()) > 0;
+					
+					AddressesT cached_addresses;
+					int cached_error = -1;
+					
+					examiner << "Result is cached.";
+					examiner.check(resolver->lookup("localhost", "http", SOCK_STREAM, cached_addresses, cached_error));
+					examiner.expect(cached_addresses.size()) == resolved_addresses.size();
+					
+					resolver->resolve(event_loop.get(), "localhost", "http", SOCK_STREAM, callback);
+					
+					examiner << "Cached request doesn't require resolution.";
+					examiner.expect(resolver->cache_hit_count()) == 1;
+				}
+			},
+			
+			{"it should cache failed lookups",
+				[](UnitTest::Examiner & examiner) {
+					Ref<Events::Loop> event_loop = new Events::Loop;
+					event_loop->set_stop_when_idle(false);
+					
+					Ref<Resolver> resolver = new Resolver(1);
+					
+					int resolved_error = 0;
+					
+					resolver->resolve(event_loop.get(), "localhost", "ThisServiceDoesNotExist", SOCK_STREAM, [&](Events::Loop * loop, const AddressesT & addresses, int error) {
+						resolved_error = error;
+						
+						loop->stop();
+					});
+					
+					event_loop->schedule_timer(new Events::TimerSource(stop_resolver_callback, 5));
+					event_loop->run_forever();
+					
+					examiner << "Lookup failed.";
+					examiner.expect(resolved_error) != 0;
+					
+					AddressesT cached_addresses;
+					int cached_error = 0;
+					
+					examiner << "Failure is cached.";
+					examiner.check(resolver->lookup("localhost", "ThisServiceDoesNotExist", SOCK_STREAM, cached_addresses, cached_error));
+					examiner.expect(cached_error) == resolved_error;
+				}
+			},
+			
+			{"it should bound the number of cached results",
+				[](UnitTest::Examiner & examiner) {
+					Ref<Events::Loop> event_loop = new Events::Loop;
+					event_loop->set_stop_when_idle(false);
+					
+					Ref<Resolver> resolver = new Resolver(1, 60, 5, 4);
+					
+					std::size_t completed = 0, count = 16;
+					
+					// Numeric services resolve without consulting the network, and each is cached under its own key:
+					for (std::size_t i = 0; i < count; i += 1) {
+						resolver->resolve(event_loop.get(), "127.0.0.1", std::to_string(1000 + i), SOCK_STREAM, [&](Events::Loop * loop, const AddressesT & addresses, int error) {
+							completed += 1;
+							
+							if (completed == count)
+								loop->stop();
+						});
+					}
+					
+					event_loop->schedule_timer(new Events::TimerSource(stop_resolver_callback, 5));
+					event_loop->run_forever();
+					
+					examiner << "All requests completed.";
+					examiner.expect(completed) == count;
+					
+					examiner << "The cache didn't grow beyond its maximum size.";
+					examiner.expect(resolver->cache_size()) == 4;
+					
+					AddressesT cached_addresses;
+					int cached_error = -1;
+					
+					examiner << "The most recent result is still cached.";
+					examiner.check(resolver->lookup("127.0.0.1", std::to_string(1000 + count - 1), SOCK_STREAM, cached_addresses, cached_error));
+				}
+			},
+		};
+	}
+}
@@ -16,6 +16,12 @@
 
 #include <functional>
 #include <future>
+#include <atomic>
+#include <map>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
 
 #include <Euclid/Numerics/Average.hpp>
 
@@ -152,9 +158,24 @@ namespace Dream
 				client_socket->message_received_callback = std::bind(&PingPongServer::message_received, this, std::placeholders::_1);
 
 				event_loop->monitor(client_socket);
+
+				{
+					scoped_lock lock(_connection_loops_lock);
+					_connection_loops[event_loop] += 1;
+				}
 			}
 
+			std::mutex _connection_loops_lock;
+			std::map<Loop *, std::size_t> _connection_loops;
+
 		public:
+			/// The number of connections handled by each runloop.
+			std::map<Loop *, std::size_t> connection_loops () {
+				scoped_lock lock(_connection_loops_lock);
+
+				return _connection_loops;
+			}
+
 			PingPongServer (Ref<Loop> event_loop, const Service & service, SocketType socket_type) : Server(event_loop)
 			{
 				auto addresses = Address::addresses_for_name("127.1", service, socket_type);
@@ -169,6 +190,94 @@ namespace Dream
 			}
 		};
 
+		class AcceptCountingServer : public Server {
+		protected:
+			virtual void connection_callback (Loop * event_loop, ServerSocket * server_socket, const SocketHandleT & h, const Address & a)
+			{
+				::close(h);
+
+				accepted_count += 1;
+			}
+
+		public:
+			std::atomic<std::size_t> accepted_count;
+
+			AcceptCountingServer (Ref<Loop> event_loop, const Service & service, SocketType socket_type, bool sharded) : Server(event_loop), accepted_count(0)
+			{
+				set_sharded(sharded);
+
+				auto addresses = Address::addresses_for_name("127.1", service, socket_type);
+
+				for (auto & address : addresses) {
+					bind_to_address(address);
+				}
+			}
+		};
+
+		class HandoffServer : public Server {
+		protected:
+			virtual void connection_callback (Loop * event_loop, ServerSocket * server_socket, const SocketHandleT & h, const Address & a)
+			{
+				::close(h);
+
+				accepted_count += 1;
+			}
+
+		public:
+			std::atomic<std::size_t> accepted_count;
+
+			HandoffServer (Ref<Loop> event_loop, const std::vector<SocketHandleT> & listening_handles, const Service & service, bool sharded = false) : Server(event_loop, listening_handles), accepted_count(0)
+			{
+				set_sharded(sharded);
+
+				// Binding as usual reuses the adopted sockets:
+				for (auto & address : Address::addresses_for_name("127.1", service, SOCK_STREAM))
+					bind_to_address(address);
+			}
+		};
+
+		static void run_connecting_client_process (std::size_t count) {
+			AddressesT server_addresses = Address::addresses_for_name("127.1", "2405", SOCK_STREAM);
+
+			for (std::size_t i = 0; i < count; i += 1) {
+				Ref<ClientSocket> client_socket = new ClientSocket;
+
+				client_socket->connect(server_addresses);
+			}
+		}
+
+		static TimeT measure_accept_rate (bool sharded, std::size_t client_count, std::size_t connection_count, std::size_t & accepted_count) {
+			Ref<ServerContainer> container(new ServerContainer(4));
+
+			Ref<AcceptCountingServer> server(new AcceptCountingServer(container->event_loop(), "2405", SOCK_STREAM, sharded));
+			container->start(server);
+
+			sleep(1);
+
+			Timer timer;
+			std::vector<std::future<void>> children;
+
+			for (std::size_t i = 0; i < client_count; i += 1)
+				children.push_back(std::async(std::launch::async, run_connecting_client_process, connection_count));
+
+			for (auto & thread : children) {
+				thread.get();
+			}
+
+			// Wait for the server to catch up with the backlog:
+			while (server->accepted_count < client_count * connection_count && timer.time() < 10.0) {
+				std::this_thread::yield();
+			}
+
+			TimeT duration = timer.time();
+
+			container->stop();
+
+			accepted_count = server->accepted_count;
+
+			return (accepted_count / duration);
+		}
+
 		UnitTest::Suite LoopTestSuite {
 			"Dream::Network::Server",
 	
@@ -213,6 +322,210 @@ namespace Dream
 					}
 				}
 			},
+			
+			{"a complete server distributing connections across worker loops",
+				[](UnitTest::Examiner & examiner) {
+					int k = 100;
+
+					Ref<ServerContainer> container(new ServerContainer(4));
+
+					examiner << "Container has worker loops.";
+					examiner.expect(container->worker_loops().size()) == 4;
+
+					Ref<PingPongServer> server(new PingPongServer(container->event_loop(), "2404", SOCK_STREAM));
+					container->start(server);
+
+					std::vector<std::future<void>> children;
+
+					sleep(1);
+					for (int i = 0; i < 4; i += 1)
+						children.push_back(std::async(run_efficient_client_process, k));
+
+					for(auto & thread : children) {
+						thread.get();
+					}
+
+					container->stop();
+
+					auto connection_loops = server->connection_loops();
+
+					examiner << "No connections were handled on the server runloop.";
+					examiner.expect(connection_loops.count(container->event_loop().get())) == 0;
+
+					examiner << "Connections were distributed across several worker runloops.";
+					examiner.expect(connection_loops.size()) > 1;
+
+					for (auto & entry : connection_loops) {
+						bool is_worker_loop = false;
+
+						for (auto worker_loop : container->worker_loops())
+							is_worker_loop = is_worker_loop || worker_loop.get() == entry.first;
+
+						examiner.check(is_worker_loop);
+					}
+
+					{
+						scoped_lock lock(global_latency_lock);
+						log("Average latency (worker loops):", global_latency.value() * 1000.0, "ms");
+					}
+				}
+			},
+
+			{"sharded and single listeners accept every connection",
+				[](UnitTest::Examiner & examiner) {
+					std::size_t single_count = 0, sharded_count = 0;
+
+					// The rates are logged for comparison only, as they depend too much on the machine to assert anything about them:
+					TimeT single_rate = measure_accept_rate(false, 4, 2000, single_count);
+					log("Accept rate (single listener):", single_rate, "connections/s");
+
+					TimeT sharded_rate = measure_accept_rate(true, 4, 2000, sharded_count);
+					log("Accept rate (sharded listeners):", sharded_rate, "connections/s");
+
+					examiner << "Every connection was accepted.";
+					examiner.expect(single_count) == 4 * 2000;
+					examiner.expect(sharded_count) == 4 * 2000;
+				}
+			},
+
+			{"a sharded server container can be stopped and started again",
+				[](UnitTest::Examiner & examiner) {
+					Ref<ServerContainer> container(new ServerContainer(2));
+
+					Ref<AcceptCountingServer> server(new AcceptCountingServer(container->event_loop(), "2407", SOCK_STREAM, true));
+					container->start(server);
+					container->stop();
+
+					// Restarting rebinds the shards to the worker loops, rather than tripping over the previous ones:
+					container->start(server);
+
+					Ref<ClientSocket> client_socket = new ClientSocket;
+
+					examiner << "Connections are accepted after restarting.";
+					examiner.check(client_socket->connect(Address::addresses_for_name("127.1", "2407", SOCK_STREAM)));
+
+					Timer timer;
+
+					while (server->accepted_count == 0 && timer.time() < 5.0) {
+						std::this_thread::yield();
+					}
+
+					container->stop();
+
+					examiner.expect(server->accepted_count.load()) == 1;
+				}
+			},
+
+			{"a new server adopts listening sockets without refusing connections",
+				[](UnitTest::Examiner & examiner) {
+					Ref<Loop> old_loop = new Loop, new_loop = new Loop;
+					Ref<AcceptCountingServer> old_server = new AcceptCountingServer(old_loop, "2406", SOCK_STREAM, false);
+
+					std::vector<SocketHandleT> old_handles = old_server->listening_handles();
+
+					examiner << "Listening handles can be exported through the environment.";
+					old_server->export_listeners("DREAM_TEST_LISTEN_FDS");
+					examiner.check(Server::import_listeners("DREAM_TEST_LISTEN_FDS") == old_handles);
+					examiner.check(::getenv("DREAM_TEST_LISTEN_FDS") == nullptr);
+
+					SocketHandleT pair[2];
+					examiner.expect(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair)) == 0;
+
+					Ref<ClientSocket> channel = new ClientSocket(pair[0], Address());
+					Ref<ClientSocket> peer = new ClientSocket(pair[1], Address());
+
+					examiner.check(old_server->send_listeners(channel.get()).is_ok());
+
+					std::vector<SocketHandleT> handles;
+					examiner.check(Server::receive_listeners(peer.get(), handles).is_ok());
+
+					examiner << "All listening sockets were received.";
+					examiner.expect(handles.size()) == old_handles.size();
+
+					Ref<HandoffServer> new_server = new HandoffServer(new_loop, handles, "2406");
+
+					examiner << "Binding to the same addresses reused the adopted sockets.";
+					examiner.check(new_server->listening_handles() == handles);
+
+					// The old server releases its copies of the sockets, which remain open in the new server:
+					old_server->stop_accepting();
+					examiner.expect(old_server->listening_handles().size()) == 0;
+
+					Ref<ClientSocket> client_socket = new ClientSocket;
+
+					examiner << "Connections are still accepted.";
+					examiner.check(client_socket->connect(Address::addresses_for_name("127.1", "2406", SOCK_STREAM)));
+
+					new_loop->schedule_timer(new TimerSource([](Loop * event_loop, TimerSource *, Event) {
+						event_loop->stop();
+					}, 0.1));
+
+					new_loop->run_forever();
+
+					examiner.expect(new_server->accepted_count.load()) == 1;
+				}
+			},
+
+			{"a new sharded server adopts the shards of the old server",
+				[](UnitTest::Examiner & examiner) {
+					Ref<Loop> old_loop = new Loop, old_worker_loop = new Loop;
+					Ref<AcceptCountingServer> old_server = new AcceptCountingServer(old_loop, "2408", SOCK_STREAM, true);
+					old_server->set_worker_loops({old_worker_loop});
+
+					std::vector<SocketHandleT> old_handles = old_server->listening_handles();
+
+					examiner << "The shards are handed over along with the listening sockets.";
+					examiner.expect(old_handles.size()) == 2;
+
+					SocketHandleT pair[2];
+					examiner.expect(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair)) == 0;
+
+					Ref<ClientSocket> channel = new ClientSocket(pair[0], Address());
+					Ref<ClientSocket> peer = new ClientSocket(pair[1], Address());
+
+					examiner.check(old_server->send_listeners(channel.get()).is_ok());
+
+					std::vector<SocketHandleT> handles;
+					examiner.check(Server::receive_listeners(peer.get(), handles).is_ok());
+
+					Ref<Loop> new_loop = new Loop, new_worker_loop = new Loop;
+					Ref<HandoffServer> new_server = new HandoffServer(new_loop, handles, "2408", true);
+					new_server->set_worker_loops({new_worker_loop});
+
+					examiner << "The adopted shard was reused rather than binding a new one.";
+					examiner.check(new_server->listening_handles() == handles);
+
+					old_server->stop_accepting();
+
+					// The kernel distributes these between both listening sockets, so some are queued on the adopted shard:
+					std::vector<Ref<ClientSocket>> client_sockets;
+
+					for (std::size_t i = 0; i < 16; i += 1) {
+						Ref<ClientSocket> client_socket = new ClientSocket;
+
+						examiner.check(client_socket->connect(Address::addresses_for_name("127.1", "2408", SOCK_STREAM)));
+
+						client_sockets.push_back(client_socket);
+					}
+
+					auto stop_loop = [](Loop * event_loop, TimerSource *, Event) {
+						event_loop->stop();
+					};
+
+					new_worker_loop->schedule_timer(new TimerSource(stop_loop, 0.2));
+					new_loop->schedule_timer(new TimerSource(stop_loop, 0.2));
+
+					std::thread worker_thread([&]() {
+						new_worker_loop->run_forever();
+					});
+
+					new_loop->run_forever();
+					worker_thread.join();
+
+					examiner << "Connections queued on either socket are accepted.";
+					examiner.expect(new_server->accepted_count.load()) == 16;
+				}
+			},
 		};
 	}
 }
@@ -11,6 +11,12 @@
 #include <Dream/Network/Server.hpp>
 #include <Dream/Core/Logger.hpp>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <cstring>
+#include <string>
+
 namespace Dream
 {
 	namespace Network
@@ -143,6 +149,101 @@ namespace Dream
 					examiner.expect(global_message_sent_count) == global_message_received_count;
 				}
 			},
+
+			{"it should accept non-blocking connections within the accept budget",
+				[](UnitTest::Examiner & examiner) {
+					Address address = Address::addresses_for_name("127.1", "7980", SOCK_STREAM)[0];
+					Ref<ServerSocket> server_socket = new ServerSocket(address);
+
+					std::vector<SocketHandleT> accepted;
+					server_socket->connection_callback = [&](Events::Loop *, ServerSocket *, const SocketHandleT & h, const Address & a) {
+						accepted.push_back(h);
+					};
+
+					server_socket->set_accept_budget(2);
+
+					std::vector<Ref<ClientSocket>> client_sockets;
+					for (std::size_t i = 0; i < 3; i += 1) {
+						Ref<ClientSocket> client_socket = new ClientSocket;
+						client_socket->connect(address);
+						client_sockets.push_back(client_socket);
+					}
+
+					server_socket->process_events(nullptr, Events::READ_READY);
+
+					examiner << "Accepted connections up to the budget.";
+					examiner.expect(accepted.size()) == 2;
+
+					server_socket->process_events(nullptr, Events::READ_READY);
+
+					examiner << "Accepted remaining connections.";
+					examiner.expect(accepted.size()) == 3;
+
+					for (auto h : accepted) {
+						examiner << "Accepted socket is non-blocking.";
+						examiner.check(fcntl(h, F_GETFL, 0) & O_NONBLOCK);
+
+						examiner << "Accepted socket is close-on-exec.";
+						examiner.check(fcntl(h, F_GETFD, 0) & FD_CLOEXEC);
+
+						::close(h);
+					}
+				}
+			},
+			
+			{"it should accept unix-domain connections and pass them to another process",
+				[](UnitTest::Examiner & examiner) {
+					std::string path = "/tmp/dream-test-" + std::to_string(getpid()) + ".sock";
+					Address address = Address::unix_address(path);
+					
+					Ref<ServerSocket> server_socket = new ServerSocket(address);
+					
+					examiner << "Binding again replaces the existing socket.";
+					server_socket = new ServerSocket(address);
+					
+					SocketHandleT accepted = -1;
+					Address accepted_address;
+					server_socket->connection_callback = [&](Events::Loop *, ServerSocket *, const SocketHandleT & h, const Address & a) {
+						accepted = h;
+						accepted_address = a;
+					};
+					
+					Ref<ClientSocket> client_socket = new ClientSocket;
+					examiner.check(client_socket->connect(address));
+					
+					server_socket->process_events(nullptr, Events::READ_READY);
+					examiner.check(accepted != -1);
+					
+					// The front process hands the accepted connection to a worker over a socket pair:
+					SocketHandleT pair[2];
+					examiner.expect(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair)) == 0;
+					
+					Ref<ClientSocket> front = new ClientSocket(pair[0], Address());
+					Ref<ClientSocket> worker = new ClientSocket(pair[1], Address());
+					
+					examiner.check(front->try_send_connection(accepted, accepted_address).is_ok());
+					::close(accepted);
+					
+					SocketHandleT handle = -1;
+					Address handle_address;
+					
+					examiner << "The worker received the connection.";
+					examiner.check(worker->try_receive_connection(handle, handle_address).is_ok());
+					examiner.check(handle_address.is_unix());
+					examiner.check(fcntl(handle, F_GETFD, 0) & FD_CLOEXEC);
+					
+					Ref<ClientSocket> connection = new ClientSocket(handle, handle_address);
+					
+					Byte data[4] = {'p', 'a', 's', 's'}, buffer[4];
+					client_socket->send(data, sizeof(data));
+					
+					examiner << "Data from the client arrives at the worker.";
+					examiner.expect(connection->recv(buffer, sizeof(buffer))) == 4;
+					examiner.check(std::memcmp(data, buffer, sizeof(data)) == 0);
+					
+					::unlink(path.c_str());
+				}
+			},
 		};
 	}
 }